@@ -2,11 +2,27 @@
 
 #include "utils.glsl"
 
+#ifdef COMPACT_VERTEX
+layout(location = 0) in vec4 in_quantized_pos_bitangent_sign;
+layout(location = 1) in vec2 in_oct_normal;
+layout(location = 2) in vec2 in_uv;
+layout(location = 3) in vec2 in_oct_tangent;
+layout(location = 4) in vec3 in_color;
+// Constant for the whole mesh
+layout(location = 5) in vec3 in_pos_offset;
+layout(location = 6) in vec3 in_pos_scale;
+#else
 layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec2 in_uv;
 layout(location = 3) in vec4 in_tangent_bitangent_sign;
 layout(location = 4) in vec3 in_color;
+#endif
+
+// Added to gl_InstanceID, constant 0 unless drawn by StaticMesh::draw_indirect. Replaces gl_BaseInstance, which would
+// need ARB_shader_draw_parameters.
+// GPU-driven draws fetch it per instance, as object index minus instance slot
+layout(location = 7) in uint in_instance_offset;
 
 layout(location = 0) out vec3 out_normal;
 layout(location = 1) out vec2 out_uv;
@@ -26,7 +42,14 @@ layout(binding = 2) buffer Models {
 };
 
 void main() {
-    const mat4 model = models[gl_InstanceID].transform;
+#ifdef COMPACT_VERTEX
+    const vec3 in_pos = in_pos_offset + in_quantized_pos_bitangent_sign.xyz * in_pos_scale;
+    const vec3 in_normal = oct_decode(in_oct_normal);
+    const vec4 in_tangent_bitangent_sign = vec4(oct_decode(in_oct_tangent), in_quantized_pos_bitangent_sign.w * 2.0 - 1.0);
+#endif
+
+    const int instance = gl_InstanceID + int(in_instance_offset);
+    const mat4 model = models[instance].transform;
     const vec4 position = model * vec4(in_pos, 1.0);
 
     out_normal = normalize(mat3(model) * in_normal);
@@ -39,5 +62,5 @@ void main() {
 
     gl_Position = frame.camera.view_proj * position;
 
-    instanceID = gl_InstanceID;
+    instanceID = instance;
 }
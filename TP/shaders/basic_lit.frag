@@ -2,6 +2,7 @@
 // basic_lit.frag
 
 #include "utils.glsl"
+#include "clusters.glsl"
 
 layout(location = 0) out vec4 out_color;
 
@@ -23,6 +24,15 @@ layout(binding = 1) buffer PointLights {
     PointLight point_lights[];
 };
 
+layout(binding = 2) uniform Clusters {
+    ClusterData clusters;
+};
+
+// Per cluster: light count, then max_lights indices into point_lights
+layout(binding = 11) readonly buffer ClusterLights {
+    uint cluster_lights[];
+};
+
 const vec3 ambient = vec3(0.0);
 
 void main() {
@@ -37,19 +47,18 @@ void main() {
 
     vec3 acc = frame.sun_color * max(0.0, dot(frame.sun_dir, normal)) + ambient;
 
-    for(uint i = 0; i != frame.point_light_count; ++i) {
-        PointLight light = point_lights[i];
-        const vec3 to_light = (light.position - in_position);
-        const float dist = length(to_light);
-        const vec3 light_vec = to_light / dist;
-
-        const float NoL = dot(light_vec, normal);
-        const float att = attenuation(dist, light.radius);
-        if(NoL <= 0.0 || att <= 0.0f) {
-            continue;
+    if(clusters.enabled != 0u) {
+        const uint first_index = cluster_index(clusters, gl_FragCoord.xy / frame.window_size, gl_FragCoord.z) * (clusters.max_lights + 1u);
+        const uint light_count = cluster_lights[first_index];
+        for(uint i = 0; i != light_count; ++i) {
+            const PointLight light = point_lights[cluster_lights[first_index + 1u + i]];
+            acc += light.color * light_contribution(light, in_position, normal);
+        }
+    } else {
+        for(uint i = 0; i != frame.point_light_count; ++i) {
+            const PointLight light = point_lights[i];
+            acc += light.color * light_contribution(light, in_position, normal);
         }
-
-        acc += light.color * (NoL * att);
     }
 
     out_color = vec4(in_color * acc, 1.0);
@@ -0,0 +1,39 @@
+// Froxel clusters: screen tiles split into depth slices whose bounds grow exponentially with the view distance.
+// Slice i covers [slice_near * exp((i - 1) / slice_scale), slice_near * exp(i / slice_scale)], slice 0 starts at the camera
+
+uint cluster_slice(ClusterData clusters, float view_distance) {
+    const float slice = floor(log(view_distance / clusters.slice_near) * clusters.slice_scale) + 1.0;
+    return uint(clamp(slice, 0.0, float(clusters.grid_size.z - 1u)));
+}
+
+float slice_start(ClusterData clusters, uint slice) {
+    return slice == 0u ? 0.0 : clusters.slice_near * exp(float(slice - 1u) / clusters.slice_scale);
+}
+
+float slice_end(ClusterData clusters, uint slice) {
+    return slice == clusters.grid_size.z - 1u ? 1.0e20 : clusters.slice_near * exp(float(slice) / clusters.slice_scale);
+}
+
+// uv in [0, 1] over the window, depth as written by the infinite reverse-Z projection
+uint cluster_index(ClusterData clusters, vec2 uv, float depth) {
+    const uvec2 tile = min(uvec2(uv * vec2(clusters.grid_size.xy)), clusters.grid_size.xy - 1u);
+    const uint slice = cluster_slice(clusters, clusters.z_near / depth);
+    return (slice * clusters.grid_size.y + tile.y) * clusters.grid_size.x + tile.x;
+}
+
+// View space box of the cluster
+void cluster_bounds(ClusterData clusters, uint cluster, out vec3 box_min, out vec3 box_max) {
+    const uvec3 coord = uvec3(cluster % clusters.grid_size.x, (cluster / clusters.grid_size.x) % clusters.grid_size.y, cluster / (clusters.grid_size.x * clusters.grid_size.y));
+    const vec2 ndc_min = vec2(coord.xy) / vec2(clusters.grid_size.xy) * 2.0 - 1.0;
+    const vec2 ndc_max = vec2(coord.xy + 1u) / vec2(clusters.grid_size.xy) * 2.0 - 1.0;
+    const float near_dist = slice_start(clusters, coord.z);
+    const float far_dist = slice_end(clusters, coord.z);
+
+    // The view looks down -Z, xy grow linearly with the distance
+    const vec2 near_min = ndc_min * near_dist / clusters.proj_scale;
+    const vec2 near_max = ndc_max * near_dist / clusters.proj_scale;
+    const vec2 far_min = ndc_min * far_dist / clusters.proj_scale;
+    const vec2 far_max = ndc_max * far_dist / clusters.proj_scale;
+    box_min = vec3(min(near_min, far_min), -far_dist);
+    box_max = vec3(max(near_max, far_max), -near_dist);
+}
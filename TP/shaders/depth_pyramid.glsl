@@ -0,0 +1,16 @@
+// Hi-Z depth pyramid stored as a flat float array, level after level.
+// Level 0 is half the viewport rounded up to powers of two: a level k texel covers 2^(k+1) pixels on each axis.
+// Depth is reversed, so texels keep the farthest (smallest) depth they cover
+
+uvec2 pyramid_level_size(uvec2 size, uint level) {
+    return max(size >> level, uvec2(1u));
+}
+
+uint pyramid_level_offset(uvec2 size, uint level) {
+    uint offset = 0;
+    for(uint i = 0; i != level; ++i) {
+        const uvec2 level_size = pyramid_level_size(size, i);
+        offset += level_size.x * level_size.y;
+    }
+    return offset;
+}
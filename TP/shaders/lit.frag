@@ -21,19 +21,6 @@ layout(binding = 1) buffer PointLights {
 
 const vec3 ambient = vec3(0.0);
 
-float light_contribution(PointLight light, vec3 frag_pos, vec3 normal) {
-    const vec3 to_light = (light.position - frag_pos);
-    const float dist = length(to_light);
-    const vec3 light_vec = to_light / dist;
-
-    const float NoL = dot(light_vec, normal);
-    const float att = attenuation(dist, light.radius);
-    if (NoL > 0.0 && att > 0.0f) {
-        return NoL * att;
-    }
-    return 0.0;
-}
-
 void main() {
     vec3 albedo = texelFetch(in_albedo_texture, ivec2(gl_FragCoord.xy), 0).rgb;
     vec3 normal = texelFetch(in_normal_texture, ivec2(gl_FragCoord.xy), 0).xyz;
@@ -47,7 +34,7 @@ void main() {
     vec2 uv = gl_FragCoord.xy / frame.window_size;
 
 #ifndef LIGHT_CULL
-    vec3 position = unproject(uv, depth, inverse(frame.camera.view_proj));
+    vec3 position = unproject(uv, depth, frame.camera.inv_view_proj);
 
     vec3 acc = frame.sun_color * max(0.0, dot(frame.sun_dir, normal)) + ambient;
 
@@ -56,7 +43,7 @@ void main() {
 #else // LIGHT_CULL
     PointLight light = point_lights[instanceID];
 
-    vec3 position = unproject(uv, depth, inverse(frame.camera.view_proj));
+    vec3 position = unproject(uv, depth, frame.camera.inv_view_proj);
     vec3 acc = light.color * light_contribution(light, position, normal);
 
     out_color = vec4(albedo * acc, 1.0); // Additive blending
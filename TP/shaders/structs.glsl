@@ -1,12 +1,19 @@
 struct CameraData {
     mat4 view_proj;
+    mat4 inv_view_proj; // so that shaders don't have to invert view_proj themselves
+
+    vec3 position; // 12 bytes
+    float padding_1; // 4 bytes
+
+    vec3 forward; // 12 bytes
+    float padding_2; // 4 bytes
 };
 
 struct FrameData {
     vec2 window_size; // 8 bytes
     vec2 padding_1; // 8 bytes
 
-    CameraData camera; // 64 bytes
+    CameraData camera; // 160 bytes
 
     vec3 sun_dir; // 12 bytes
     uint point_light_count; // 4 bytes
@@ -25,3 +32,49 @@ struct PointLight {
 struct Model {
     mat4 transform;
 };
+
+struct CullingData {
+    vec4 planes[5]; // xyz: normal, w: dot(normal, camera position)
+
+    vec3 camera_position; // 12 bytes
+    uint object_count; // 4 bytes
+
+    float lod_pixel_scale; // pixels covered by one world unit at a distance of 1
+    float lod_pixel_error; // 0 keeps every object at LOD 0
+    uint occlusion_pass; // 0: frustum only, 1: also against the previous frame's pyramid, 2: occluded objects against this frame's
+    uint pyramid_levels;
+
+    mat4 occlusion_view_proj; // of the frame the pyramid was built in
+
+    uvec2 viewport_size; // 8 bytes
+    uvec2 pyramid_size; // 8 bytes, of level 0
+};
+
+struct CullObject {
+    vec3 sphere_center;
+    float sphere_radius;
+    vec3 box_center;
+    uint group;
+    vec3 box_extents;
+    float scale; // largest scale of the transform
+};
+
+struct ClusterData {
+    mat4 view;
+
+    vec2 proj_scale; // projection[0][0] and [1][1]: view space xy = ndc xy * distance / proj_scale
+    float z_near; // of the infinite reverse-Z projection: view distance = z_near / depth
+    uint enabled; // 0: every fragment loops over all the lights
+
+    uvec3 grid_size; // 12 bytes
+    uint max_lights; // 4 bytes, per cluster
+
+    float slice_near; // slice 0 ends there, the last one goes to infinity
+    float slice_scale; // slices per unit of log(distance)
+    vec2 padding_1; // 8 bytes
+};
+
+struct DrawGroup {
+    uint first_command; // one command per LOD
+    uint lod_count;
+};
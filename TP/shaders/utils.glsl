@@ -33,6 +33,20 @@ float attenuation(float distance, float radius, float falloff) {
     return attenuation(distance * falloff, radius * falloff);
 }
 
+// Diffuse factor of a point light, to be multiplied by its color
+float light_contribution(PointLight light, vec3 frag_pos, vec3 normal) {
+    const vec3 to_light = (light.position - frag_pos);
+    const float dist = length(to_light);
+    const vec3 light_vec = to_light / dist;
+
+    const float NoL = dot(light_vec, normal);
+    const float att = attenuation(dist, light.radius);
+    if(NoL > 0.0 && att > 0.0) {
+        return NoL * att;
+    }
+    return 0.0;
+}
+
 float sRGB_to_linear(float x) {
     if(x <= 0.04045) {
         return x / 12.92;
@@ -60,6 +74,15 @@ vec3 unpack_normal_map(vec2 normal) {
     return vec3(normal, 1.0 - sqrt(dot(normal, normal)));
 }
 
+// Octahedral encoded unit vector, see VertexCompression.cpp
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
 vec3 unproject(vec2 uv, float depth, mat4 inv_viewproj) {
     const vec3 ndc = vec3(uv * 2.0 - vec2(1.0), depth);
     const vec4 p = inv_viewproj * vec4(ndc, 1.0);
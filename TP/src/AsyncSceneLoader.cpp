@@ -0,0 +1,174 @@
+#include "AsyncSceneLoader.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace OM3D {
+
+SceneUploader::SceneUploader(const SceneData& data, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) :
+    _data(data),
+    _pipeline(pipeline),
+    _defines(defines.begin(), defines.end()),
+    _scene(std::make_unique<Scene>()) {
+
+    // Vertex formats are chosen per scene, so every material uses the same vertex shader variant
+    // Quantized meshes describe their layout to GL and use the same inputs as Vertex
+    const bool compact = std::any_of(data.meshes.begin(), data.meshes.end(), [](const SceneData::Mesh& mesh) {
+        return mesh.vertex_format == VertexFormat::Compact || mesh.vertex_format == VertexFormat::CompactColor;
+    });
+    if(compact) {
+        const std::string required_defines[] = {"COMPACT_VERTEX"};
+        _scene->set_required_defines(required_defines);
+        _defines.insert(_defines.begin(), std::begin(required_defines), std::end(required_defines));
+    }
+}
+
+bool SceneUploader::upload_next() {
+    if(_textures.size() != _data.images.size()) {
+        const SceneData::Image& image = _data.images[_textures.size()];
+        _textures.push_back(std::make_shared<Texture>(image.size, image.format, image.data, image.mip_levels));
+        return true;
+    }
+
+    if(_materials.size() != _data.materials.size()) {
+        const SceneData::Material& mat = _data.materials[_materials.size()];
+        const auto albedo = mat.albedo >= 0 ? _textures[mat.albedo] : nullptr;
+        const auto normal = mat.normal >= 0 ? _textures[mat.normal] : nullptr;
+
+        std::shared_ptr<Material> material;
+        if(!albedo) {
+            material = Material::material(_pipeline, _defines);
+        } else if(!normal) {
+            material = Material::textured_material(_pipeline, _defines);
+            material->set_texture(0u, albedo);
+        } else {
+            material = Material::textured_normal_mapped_material(_pipeline, _defines);
+            material->set_texture(0u, albedo);
+            material->set_texture(1u, normal);
+        }
+        _materials.push_back(std::move(material));
+        return true;
+    }
+
+    if(_meshes.size() != _data.meshes.size()) {
+        const SceneData::Mesh& mesh = _data.meshes[_meshes.size()];
+        _meshes.push_back(std::make_shared<StaticMesh>(mesh.vertex_format, mesh.vertices, mesh.dequantization, mesh.quantized_layout, mesh.index_type, mesh.indices, mesh.meshlets, mesh.lods, mesh.hash, mesh.bounds));
+        return true;
+    }
+
+    if(!_objects_added) {
+        for(const SceneData::Object& obj : _data.objects) {
+            auto scene_object = SceneObject(_meshes[obj.mesh], obj.material >= 0 ? _materials[obj.material] : nullptr);
+            scene_object.set_transform(obj.transform);
+            _scene->add_object(std::move(scene_object));
+        }
+
+        for(const SceneData::Light& l : _data.point_lights) {
+            PointLight light;
+            light.set_position(l.position);
+            light.set_color(l.color);
+            light.set_radius(l.radius);
+            _scene->add_object(std::move(light));
+        }
+
+        _objects_added = true;
+    }
+
+    return false;
+}
+
+bool SceneUploader::is_done() const {
+    return _objects_added;
+}
+
+float SceneUploader::progress() const {
+    const size_t total = _data.images.size() + _data.materials.size() + _data.meshes.size() + 1;
+    const size_t uploaded = _textures.size() + _materials.size() + _meshes.size() + (_objects_added ? 1 : 0);
+    return float(uploaded) / float(total);
+}
+
+std::unique_ptr<Scene> SceneUploader::finish() {
+    while(upload_next()) {
+    }
+    return std::move(_scene);
+}
+
+
+
+AsyncSceneLoader::AsyncSceneLoader(std::string file_name, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines, const SceneImportSettings& settings) :
+    _file_name(std::move(file_name)),
+    _pipeline(pipeline),
+    _defines(defines.begin(), defines.end()) {
+
+    _future = std::async(std::launch::async, [file = _file_name, settings] {
+        return SceneData::from_gltf(file, settings);
+    });
+}
+
+AsyncSceneLoader::~AsyncSceneLoader() {
+    // Don't leave the worker running with nobody to collect its result
+    if(_future.valid()) {
+        _future.wait();
+    }
+}
+
+bool AsyncSceneLoader::update(double budget_ms) {
+    if(is_done()) {
+        return true;
+    }
+
+    if(!_uploader) {
+        if(_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+
+        _data = _future.get();
+        if(!_data.is_ok) {
+            std::cerr << "Unable to load scene (" << _file_name << ")" << std::endl;
+            _failed = true;
+            return true;
+        }
+
+        _uploader = std::make_unique<SceneUploader>(_data.value, _pipeline, _defines);
+    }
+
+    // Always upload at least one resource per call so that loading can't stall on a small budget
+    const double start = program_time();
+    do {
+        if(!_uploader->upload_next()) {
+            _scene = _uploader->finish();
+            _uploader = nullptr;
+            _data = {false, {}};
+            return true;
+        }
+    } while((program_time() - start) * 1000.0 < budget_ms);
+
+    return false;
+}
+
+bool AsyncSceneLoader::is_done() const {
+    return _scene || _failed;
+}
+
+bool AsyncSceneLoader::has_failed() const {
+    return _failed;
+}
+
+float AsyncSceneLoader::progress() const {
+    if(is_done()) {
+        return 1.0f;
+    }
+    // Decoding is reported as the first half of the loading
+    return _uploader ? 0.5f + _uploader->progress() * 0.5f : 0.0f;
+}
+
+const std::string& AsyncSceneLoader::file_name() const {
+    return _file_name;
+}
+
+std::unique_ptr<Scene> AsyncSceneLoader::take_scene() {
+    DEBUG_ASSERT(_scene);
+    return std::move(_scene);
+}
+
+}
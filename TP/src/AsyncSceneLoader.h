@@ -0,0 +1,73 @@
+#ifndef ASYNCSCENELOADER_H
+#define ASYNCSCENELOADER_H
+
+#include <Scene.h>
+#include <SceneData.h>
+
+#include <future>
+
+namespace OM3D {
+
+// Creates the GL objects of a SceneData one resource at a time, so uploads can be spread over several frames.
+// The SceneData must outlive the uploader.
+class SceneUploader : NonMovable {
+
+    public:
+        SceneUploader(const SceneData& data, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines = {});
+
+        // Uploads the next pending resource, returns false once everything has been uploaded
+        bool upload_next();
+
+        bool is_done() const;
+        float progress() const;
+
+        std::unique_ptr<Scene> finish();
+
+    private:
+        const SceneData& _data;
+        std::pair<const char *, const char *> _pipeline;
+        std::vector<std::string> _defines;
+
+        std::unique_ptr<Scene> _scene;
+        std::vector<std::shared_ptr<Texture>> _textures;
+        std::vector<std::shared_ptr<Material>> _materials;
+        std::vector<std::shared_ptr<StaticMesh>> _meshes;
+        bool _objects_added = false;
+};
+
+// Loads a scene in the background: file I/O, parsing and decoding run on worker threads,
+// while update() performs the GPU uploads on the GL thread within a per call time budget.
+class AsyncSceneLoader : NonMovable {
+
+    public:
+        AsyncSceneLoader(std::string file_name, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines = {}, const SceneImportSettings& settings = {});
+        ~AsyncSceneLoader();
+
+        // Must be called from the GL thread, returns true once the scene is ready or has failed to load
+        bool update(double budget_ms);
+
+        bool is_done() const;
+        bool has_failed() const;
+        float progress() const;
+
+        const std::string& file_name() const;
+
+        // Only valid once the loading is done and successful
+        std::unique_ptr<Scene> take_scene();
+
+    private:
+        std::string _file_name;
+        std::pair<const char *, const char *> _pipeline;
+        std::vector<std::string> _defines;
+
+        std::future<Result<SceneData>> _future;
+        Result<SceneData> _data = {false, {}};
+
+        std::unique_ptr<SceneUploader> _uploader;
+        std::unique_ptr<Scene> _scene;
+        bool _failed = false;
+};
+
+}
+
+#endif // ASYNCSCENELOADER_H
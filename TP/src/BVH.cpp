@@ -0,0 +1,288 @@
+#include "BVH.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace OM3D {
+
+static constexpr u32 bin_count = 16;
+static constexpr u32 max_leaf_objects = 4;
+
+// Cost of visiting a node, relative to testing one object
+static constexpr float traversal_cost = 1.0f;
+
+// Refitting is cheaper than building, until the tree gets this much worse than a fresh one
+static constexpr float max_refit_degradation = 2.0f;
+
+// Min/max form, which is easier to grow than CenteredBox
+struct Box {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void extend(const Box& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    void extend(const CenteredBox& box) {
+        min = glm::min(min, box.center - box.extents);
+        max = glm::max(max, box.center + box.extents);
+    }
+
+    float half_area() const {
+        const glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+};
+
+static float node_half_area(const glm::vec3& extents) {
+    return 4.0f * (extents.x * extents.y + extents.y * extents.z + extents.z * extents.x);
+}
+
+void BVH::build(Span<const CenteredBox> boxes) {
+    _nodes.clear();
+    _objects.resize(boxes.size());
+    for(u32 i = 0; i != boxes.size(); ++i) {
+        _objects[i] = i;
+    }
+
+    if(boxes.is_empty()) {
+        _build_cost = 0.0f;
+        return;
+    }
+
+    std::vector<glm::vec3> centroids(boxes.size());
+    for(size_t i = 0; i != boxes.size(); ++i) {
+        centroids[i] = boxes[i].center;
+    }
+
+    _nodes.reserve(2 * (boxes.size() / max_leaf_objects) + 1);
+    build_node(boxes, centroids, 0, u32(boxes.size()));
+    _build_cost = sah_cost();
+}
+
+u32 BVH::build_node(Span<const CenteredBox> boxes, Span<const glm::vec3> centroids, u32 first, u32 count) {
+    Box bounds;
+    Box centroid_bounds;
+    for(u32 i = first; i != first + count; ++i) {
+        bounds.extend(boxes[_objects[i]]);
+        centroid_bounds.extend(CenteredBox{centroids[_objects[i]], glm::vec3(0.0f)});
+    }
+
+    const u32 index = u32(_nodes.size());
+    {
+        Node& node = _nodes.emplace_back();
+        node.center = (bounds.min + bounds.max) * 0.5f;
+        node.extents = (bounds.max - bounds.min) * 0.5f;
+        node.first = first;
+        node.count = count;
+        node.right_child = 0;
+    }
+
+    if(count == 1) {
+        return index;
+    }
+
+    // Binned SAH: objects are binned by centroid along each axis, and the tree is split between two bins
+    float best_cost = std::numeric_limits<float>::max();
+    u32 best_axis = 0;
+    u32 best_split = 0;
+
+    const glm::vec3 centroid_size = centroid_bounds.max - centroid_bounds.min;
+    for(u32 axis = 0; axis != 3; ++axis) {
+        if(centroid_size[axis] <= 0.0f) {
+            continue;
+        }
+
+        const float bin_scale = bin_count / centroid_size[axis];
+        const auto bin_of = [&](u32 object) {
+            return std::min(bin_count - 1, u32((centroids[object][axis] - centroid_bounds.min[axis]) * bin_scale));
+        };
+
+        Box bins[bin_count];
+        u32 bin_objects[bin_count] = {};
+        for(u32 i = first; i != first + count; ++i) {
+            const u32 bin = bin_of(_objects[i]);
+            bins[bin].extend(boxes[_objects[i]]);
+            ++bin_objects[bin];
+        }
+
+        // Cost of the right side of every split, then sweep from the left
+        float right_costs[bin_count] = {};
+        Box right;
+        u32 right_objects = 0;
+        for(u32 split = bin_count - 1; split != 0; --split) {
+            right.extend(bins[split]);
+            right_objects += bin_objects[split];
+            right_costs[split] = right.half_area() * right_objects;
+        }
+
+        Box left;
+        u32 left_objects = 0;
+        for(u32 split = 1; split != bin_count; ++split) {
+            left.extend(bins[split - 1]);
+            left_objects += bin_objects[split - 1];
+            const float cost = left.half_area() * left_objects + right_costs[split];
+            if(left_objects && left_objects != count && cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    const float area = bounds.half_area();
+    const bool has_split = best_cost != std::numeric_limits<float>::max();
+    const float split_cost = traversal_cost + (area > 0.0f ? best_cost / area : float(count));
+    if(count <= max_leaf_objects && (!has_split || split_cost >= float(count))) {
+        return index;
+    }
+
+    u32 middle = first + count / 2;
+    if(has_split) {
+        const float bin_scale = bin_count / centroid_size[best_axis];
+        const auto it = std::partition(_objects.begin() + first, _objects.begin() + first + count, [&](u32 object) {
+            return std::min(bin_count - 1, u32((centroids[object][best_axis] - centroid_bounds.min[best_axis]) * bin_scale)) < best_split;
+        });
+        middle = u32(it - _objects.begin());
+    }
+    // else every centroid is the same, any split is as good
+
+    build_node(boxes, centroids, first, middle - first);
+    const u32 right_child = build_node(boxes, centroids, middle, first + count - middle);
+    _nodes[index].right_child = right_child;
+    return index;
+}
+
+void BVH::refit(Span<const CenteredBox> boxes) {
+    if(_objects.size() != boxes.size()) {
+        build(boxes);
+        return;
+    }
+
+    // Children are always after their parent
+    for(size_t i = _nodes.size(); i != 0; --i) {
+        Node& node = _nodes[i - 1];
+
+        Box bounds;
+        if(node.right_child) {
+            const Node& left = _nodes[i];
+            const Node& right = _nodes[node.right_child];
+            bounds.extend(CenteredBox{left.center, left.extents});
+            bounds.extend(CenteredBox{right.center, right.extents});
+        } else {
+            for(u32 k = node.first; k != node.first + node.count; ++k) {
+                bounds.extend(boxes[_objects[k]]);
+            }
+        }
+
+        node.center = (bounds.min + bounds.max) * 0.5f;
+        node.extents = (bounds.max - bounds.min) * 0.5f;
+    }
+
+    if(sah_cost() > _build_cost * max_refit_degradation) {
+        build(boxes);
+    }
+}
+
+// Frustum planes all go through the camera position, with normals pointing inside
+enum class Containment {
+    Outside,
+    Intersecting,
+    Inside,
+};
+
+static Containment classify(const glm::vec3 (&normals)[5], u32& plane_mask, const glm::vec3& center, const glm::vec3& extents) {
+    for(u32 plane = 0; plane != 5; ++plane) {
+        if(!(plane_mask & (1 << plane))) {
+            continue;
+        }
+
+        const float distance = glm::dot(center, normals[plane]);
+        const float radius = glm::dot(extents, glm::abs(normals[plane]));
+        if(distance + radius < 0.0f) {
+            return Containment::Outside;
+        }
+        if(distance - radius >= 0.0f) {
+            // Children are inside this plane too, no need to test it again
+            plane_mask &= ~(1u << plane);
+        }
+    }
+    return plane_mask ? Containment::Intersecting : Containment::Inside;
+}
+
+BVHCullStats BVH::cull(const Frustum& frustum, const glm::vec3& camera_position, std::vector<u32>& inside, std::vector<u32>& intersecting) const {
+    BVHCullStats stats;
+    if(_nodes.empty()) {
+        return stats;
+    }
+
+    const glm::vec3 normals[5] = {frustum._near_normal, frustum._top_normal, frustum._bottom_normal, frustum._right_normal, frustum._left_normal};
+
+    struct Entry {
+        u32 node;
+        u32 plane_mask;
+    };
+
+    std::vector<Entry> stack;
+    stack.push_back({0, 0x1F});
+    while(!stack.empty()) {
+        const Entry entry = stack.back();
+        stack.pop_back();
+
+        const Node& node = _nodes[entry.node];
+        ++stats.nodes_visited;
+
+        u32 plane_mask = entry.plane_mask;
+        const Containment containment = classify(normals, plane_mask, node.center - camera_position, node.extents);
+        if(containment == Containment::Outside) {
+            continue;
+        }
+
+        if(containment == Containment::Inside) {
+            inside.insert(inside.end(), _objects.begin() + node.first, _objects.begin() + node.first + node.count);
+            stats.objects_accepted += node.count;
+            continue;
+        }
+
+        if(node.right_child) {
+            stack.push_back({node.right_child, plane_mask});
+            stack.push_back({entry.node + 1, plane_mask});
+        } else {
+            intersecting.insert(intersecting.end(), _objects.begin() + node.first, _objects.begin() + node.first + node.count);
+        }
+    }
+
+    return stats;
+}
+
+bool BVH::is_empty() const {
+    return _nodes.empty();
+}
+
+size_t BVH::node_count() const {
+    return _nodes.size();
+}
+
+float BVH::sah_cost() const {
+    if(_nodes.empty()) {
+        return 0.0f;
+    }
+
+    const float root_area = node_half_area(_nodes[0].extents);
+    if(root_area <= 0.0f) {
+        return float(_objects.size());
+    }
+
+    float cost = 0.0f;
+    for(const Node& node : _nodes) {
+        const float probability = node_half_area(node.extents) / root_area;
+        cost += probability * (node.right_child ? traversal_cost : float(node.count));
+    }
+    return cost;
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <Bounds.h>
+#include <Camera.h>
+
+#include <vector>
+
+namespace OM3D {
+
+struct BVHCullStats {
+    size_t nodes_visited = 0;
+    // Objects of subtrees found entirely inside the frustum, which don't need to be tested individually
+    size_t objects_accepted = 0;
+};
+
+// Bounding volume hierarchy over world space boxes, one per object
+class BVH {
+
+    public:
+        // Builds the tree with the surface area heuristic, object indices are indices in `boxes`
+        void build(Span<const CenteredBox> boxes);
+
+        // Updates the node bounds after objects moved, keeping the tree as is.
+        // Rebuilds instead if the refitted tree became much more expensive to traverse than a fresh one
+        void refit(Span<const CenteredBox> boxes);
+
+        // Objects of the subtrees that are entirely in the frustum are appended to `inside`,
+        // those of the leaves intersecting it to `intersecting` (which still need to be tested individually)
+        BVHCullStats cull(const Frustum& frustum, const glm::vec3& camera_position, std::vector<u32>& inside, std::vector<u32>& intersecting) const;
+
+        bool is_empty() const;
+        size_t node_count() const;
+
+        // Surface area heuristic cost of the tree, in units of one object test
+        float sah_cost() const;
+
+    private:
+        // Nodes are stored depth first: the left child directly follows its parent
+        struct Node {
+            glm::vec3 center;
+            // Subtree's objects are _objects[first, first + count)
+            u32 first;
+            glm::vec3 extents;
+            u32 count;
+            // 0 for leaves
+            u32 right_child;
+        };
+
+        u32 build_node(Span<const CenteredBox> boxes, Span<const glm::vec3> centroids, u32 first, u32 count);
+
+        std::vector<Node> _nodes;
+        std::vector<u32> _objects;
+        float _build_cost = 0.0f;
+};
+
+}
+
+#endif // BVH_H
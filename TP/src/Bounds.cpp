@@ -0,0 +1,169 @@
+#include "Bounds.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OM3D_BOUNDS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace OM3D {
+
+static_assert(offsetof(Vertex, position) == 0 && sizeof(Vertex) >= 4 * sizeof(float), "Positions are loaded as 4 floats");
+
+#ifdef OM3D_BOUNDS_SSE
+// xyz of the position, w is garbage
+static __m128 load_position(const Vertex& vertex) {
+    return _mm_loadu_ps(&vertex.position.x);
+}
+
+static float length2(__m128 v) {
+    alignas(16) float values[4];
+    _mm_store_ps(values, _mm_mul_ps(v, v));
+    return values[0] + values[1] + values[2];
+}
+#endif
+
+MeshBounds compute_mesh_bounds(Span<const Vertex> vertices) {
+    MeshBounds bounds;
+    if(vertices.is_empty()) {
+        return bounds;
+    }
+
+    // Vertices with the smallest and largest coordinate along each axis
+    u32 min_vertex[3] = {};
+    u32 max_vertex[3] = {};
+
+#ifdef OM3D_BOUNDS_SSE
+    __m128 min = load_position(vertices[0]);
+    __m128 max = min;
+    for(u32 i = 1; i != vertices.size(); ++i) {
+        const __m128 p = load_position(vertices[i]);
+        const int below = _mm_movemask_ps(_mm_cmplt_ps(p, min));
+        const int above = _mm_movemask_ps(_mm_cmpgt_ps(p, max));
+        if((below | above) & 7) {
+            for(u32 axis = 0; axis != 3; ++axis) {
+                min_vertex[axis] = (below >> axis) & 1 ? i : min_vertex[axis];
+                max_vertex[axis] = (above >> axis) & 1 ? i : max_vertex[axis];
+            }
+            min = _mm_min_ps(min, p);
+            max = _mm_max_ps(max, p);
+        }
+    }
+
+    alignas(16) float min_values[4];
+    alignas(16) float max_values[4];
+    _mm_store_ps(min_values, min);
+    _mm_store_ps(max_values, max);
+    bounds.aabb_min = glm::vec3(min_values[0], min_values[1], min_values[2]);
+    bounds.aabb_max = glm::vec3(max_values[0], max_values[1], max_values[2]);
+#else
+    bounds.aabb_min = bounds.aabb_max = vertices[0].position;
+    for(u32 i = 1; i != vertices.size(); ++i) {
+        const glm::vec3& p = vertices[i].position;
+        for(u32 axis = 0; axis != 3; ++axis) {
+            if(p[axis] < bounds.aabb_min[axis]) {
+                bounds.aabb_min[axis] = p[axis];
+                min_vertex[axis] = i;
+            }
+            if(p[axis] > bounds.aabb_max[axis]) {
+                bounds.aabb_max[axis] = p[axis];
+                max_vertex[axis] = i;
+            }
+        }
+    }
+#endif
+
+    // Initial sphere on the most distant pair of extreme vertices
+    u32 axis = 0;
+    float best_distance = -1.0f;
+    for(u32 a = 0; a != 3; ++a) {
+        const float d = glm::length(vertices[max_vertex[a]].position - vertices[min_vertex[a]].position);
+        if(d > best_distance) {
+            best_distance = d;
+            axis = a;
+        }
+    }
+
+    glm::vec3 center = (vertices[min_vertex[axis]].position + vertices[max_vertex[axis]].position) * 0.5f;
+    float radius = best_distance * 0.5f;
+
+    // Grow it to enclose every vertex, while measuring the sphere centered on the AABB
+    const glm::vec3 box_center = (bounds.aabb_min + bounds.aabb_max) * 0.5f;
+    float box_radius2 = 0.0f;
+
+#ifdef OM3D_BOUNDS_SSE
+    const __m128 box_center4 = _mm_setr_ps(box_center.x, box_center.y, box_center.z, 0.0f);
+#endif
+    for(const Vertex& vertex : vertices) {
+#ifdef OM3D_BOUNDS_SSE
+        const __m128 p = load_position(vertex);
+        box_radius2 = std::max(box_radius2, length2(_mm_sub_ps(p, box_center4)));
+        const float d2 = length2(_mm_sub_ps(p, _mm_setr_ps(center.x, center.y, center.z, 0.0f)));
+#else
+        box_radius2 = std::max(box_radius2, glm::dot(vertex.position - box_center, vertex.position - box_center));
+        const float d2 = glm::dot(vertex.position - center, vertex.position - center);
+#endif
+        if(d2 > radius * radius) {
+            const float d = std::sqrt(d2);
+            const float new_radius = (radius + d) * 0.5f;
+            center += (vertex.position - center) * ((new_radius - radius) / d);
+            radius = new_radius;
+        }
+    }
+
+    const float box_radius = std::sqrt(box_radius2);
+    if(box_radius < radius) {
+        center = box_center;
+        radius = box_radius;
+    }
+
+    bounds.sphere_center = center;
+    bounds.sphere_radius = radius;
+    return bounds;
+}
+
+float max_scale(const glm::mat4& transform) {
+    const glm::mat3 m(transform);
+
+    // Largest singular value, bounded by the largest absolute row sum of MᵀM (Gershgorin).
+    // Off diagonal terms are zero for orthogonal axes, which makes the bound exact
+    float max_row = 0.0f;
+    for(int i = 0; i != 3; ++i) {
+        float row = 0.0f;
+        for(int j = 0; j != 3; ++j) {
+            row += std::abs(glm::dot(m[i], m[j]));
+        }
+        max_row = std::max(max_row, row);
+    }
+    return std::sqrt(max_row);
+}
+
+BoundingSphere transform_sphere(const MeshBounds& bounds, const glm::mat4& transform) {
+    BoundingSphere sphere;
+    sphere.center = glm::vec3(transform * glm::vec4(bounds.sphere_center, 1.0f));
+    sphere.radius = bounds.sphere_radius * max_scale(transform);
+    return sphere;
+}
+
+CenteredBox transform_aabb(const MeshBounds& bounds, const glm::mat4& transform) {
+    const glm::vec3 center = (bounds.aabb_min + bounds.aabb_max) * 0.5f;
+    const glm::vec3 extents = (bounds.aabb_max - bounds.aabb_min) * 0.5f;
+
+    // Each world axis extent is the sum of the absolute contributions of the local ones
+    const glm::mat3 m(transform);
+    const glm::mat3 abs_m(glm::abs(m[0]), glm::abs(m[1]), glm::abs(m[2]));
+
+    CenteredBox box;
+    box.center = glm::vec3(transform * glm::vec4(center, 1.0f));
+    box.extents = abs_m * extents;
+    return box;
+}
+
+}
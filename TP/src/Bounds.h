@@ -0,0 +1,46 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <Vertex.h>
+
+#include <glm/matrix.hpp>
+
+namespace OM3D {
+
+// Object space bounds of a mesh
+struct MeshBounds {
+    glm::vec3 aabb_min = glm::vec3(0.0f);
+    glm::vec3 aabb_max = glm::vec3(0.0f);
+
+    // Centered on the geometry, which doesn't have to contain the mesh origin
+    glm::vec3 sphere_center = glm::vec3(0.0f);
+    float sphere_radius = 0.0f;
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// Box as its center and half size
+struct CenteredBox {
+    glm::vec3 center;
+    glm::vec3 extents;
+};
+
+// The AABB and the extreme vertices along each axis are found in a single SIMD pass. The sphere is then grown from
+// the most distant pair of extreme vertices (Ritter), and replaced by the one centered on the AABB if that is smaller
+MeshBounds compute_mesh_bounds(Span<const Vertex> vertices);
+
+// Factor by which the transform scales a sphere's radius: exact for orthogonal axes, an upper bound with shear
+float max_scale(const glm::mat4& transform);
+
+// Sphere enclosing the transformed bounding sphere
+BoundingSphere transform_sphere(const MeshBounds& bounds, const glm::mat4& transform);
+
+// Box enclosing the transformed AABB
+CenteredBox transform_aabb(const MeshBounds& bounds, const glm::mat4& transform);
+
+}
+
+#endif // BOUNDS_H
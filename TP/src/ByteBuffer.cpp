@@ -36,6 +36,16 @@ size_t ByteBuffer::byte_size() const {
     return _size;
 }
 
+void ByteBuffer::copy_to(ByteBuffer& dst) const {
+    DEBUG_ASSERT(dst.byte_size() >= _size);
+    glCopyNamedBufferSubData(_handle.get(), dst._handle.get(), 0, 0, _size);
+}
+
+void ByteBuffer::read(size_t offset, size_t size, void* dst) const {
+    DEBUG_ASSERT(offset + size <= _size);
+    glGetNamedBufferSubData(_handle.get(), offset, size, dst);
+}
+
 BufferMapping<byte> ByteBuffer::map_bytes(AccessType access) {
     return BufferMapping<byte>(map_internal(access), byte_size(), handle());
 }
@@ -21,6 +21,12 @@ class ByteBuffer : NonCopyable {
 
         size_t byte_size() const;
 
+        // Copies the whole buffer on the GPU, `dst` must be at least as large
+        void copy_to(ByteBuffer& dst) const;
+
+        // Copies a range of the buffer back to `dst`, waits for the GPU to be done writing it
+        void read(size_t offset, size_t size, void* dst) const;
+
         BufferMapping<byte> map_bytes(AccessType access = AccessType::ReadWrite);
 
     protected:
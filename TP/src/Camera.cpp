@@ -47,7 +47,7 @@ void Camera::set_proj(const glm::mat4& matrix) {
 }
 
 glm::vec3 Camera::position() const {
-    return extract_position(_view);
+    return _position;
 }
 
 glm::vec3 Camera::forward() const {
@@ -76,6 +76,7 @@ const glm::mat4& Camera::view_proj_matrix() const {
 
 void Camera::update() {
     _view_proj = _projection * _view;
+    _position = extract_position(_view);
 }
 
 Frustum Camera::build_frustum() const {
@@ -106,9 +107,9 @@ Frustum Camera::build_frustum() const {
 
 bool Camera::in_frustum(const Frustum& frustum, const glm::vec3& position, float radius) const {
 
-    const auto to_vector = position - this->position();
-    const auto normals = {frustum._near_normal, frustum._top_normal, frustum._bottom_normal, frustum._right_normal, frustum._left_normal};
-    
+    const auto to_vector = position - _position;
+    const glm::vec3 normals[] = {frustum._near_normal, frustum._top_normal, frustum._bottom_normal, frustum._right_normal, frustum._left_normal};
+
     for (const auto &normal : normals) {
         auto offset_point = to_vector + normal * radius;
 
@@ -120,4 +121,21 @@ bool Camera::in_frustum(const Frustum& frustum, const glm::vec3& position, float
     return true;
 }
 
+bool Camera::in_frustum(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extents) const {
+
+    const auto to_vector = center - _position;
+    const glm::vec3 normals[] = {frustum._near_normal, frustum._top_normal, frustum._bottom_normal, frustum._right_normal, frustum._left_normal};
+
+    for (const auto &normal : normals) {
+        // Distance from the plane to the box corner that is the furthest along the normal
+        const float box_radius = glm::dot(extents, glm::abs(normal));
+
+        if (glm::dot(to_vector, normal) + box_radius < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 }
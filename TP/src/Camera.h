@@ -36,6 +36,8 @@ class Camera {
         Frustum build_frustum() const;
 
         bool in_frustum(const Frustum& frustum, const glm::vec3& position, float radius) const;
+        // Axis aligned box given by its center and half size
+        bool in_frustum(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extents) const;
 
     private:
         void update();
@@ -44,6 +46,7 @@ class Camera {
         glm::mat4 _projection;
         glm::mat4 _view;
         glm::mat4 _view_proj;
+        glm::vec3 _position;
 
         float _fov_y;
         float _aspect_ratio;
@@ -0,0 +1,187 @@
+#include "FrameAllocator.h"
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+namespace OM3D {
+
+static FrameAllocator* current_allocator = nullptr;
+
+static constexpr GLbitfield persistent_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+static GLuint create_mapped_buffer(size_t size, byte*& mapping) {
+    GLuint handle = 0;
+    glCreateBuffers(1, &handle);
+    glNamedBufferStorage(handle, size, nullptr, persistent_flags);
+    mapping = static_cast<byte*>(glMapNamedBufferRange(handle, 0, size, persistent_flags));
+    ALWAYS_ASSERT(mapping, "Unable to map buffer persistently");
+    return handle;
+}
+
+static void delete_mapped_buffer(GLuint handle) {
+    glUnmapNamedBuffer(handle);
+    glDeleteBuffers(1, &handle);
+}
+
+static size_t align_offset(size_t offset, size_t alignment) {
+    if(const size_t diff = offset % alignment) {
+        return offset + alignment - diff;
+    }
+    return offset;
+}
+
+static void wait_fence(GLsync fence) {
+    // Commands have to be flushed for the fence to be signaled, once is enough
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for(;;) {
+        switch(glClientWaitSync(fence, flags, 1'000'000)) {
+            case GL_ALREADY_SIGNALED:
+            case GL_CONDITION_SATISFIED:
+                return;
+
+            case GL_WAIT_FAILED:
+                FATAL("Waiting for frame fence failed");
+
+            default:
+                flags = 0;
+        }
+    }
+}
+
+void TransientRange::bind(BufferUsage usage) const {
+    glBindBuffer(buffer_usage_to_gl(usage), _handle);
+}
+
+void TransientRange::bind(BufferUsage usage, u32 index) const {
+    ALWAYS_ASSERT(usage == BufferUsage::Uniform || usage == BufferUsage::Storage, "Index bind is only available for uniform and storage buffers");
+    glBindBufferRange(buffer_usage_to_gl(usage), index, _handle, _offset, _size);
+}
+
+size_t TransientRange::byte_offset() const {
+    return _offset;
+}
+
+size_t TransientRange::byte_size() const {
+    return _size;
+}
+
+FrameAllocator::FrameAllocator(size_t frame_byte_size) : _frame_size(frame_byte_size) {
+    ALWAYS_ASSERT(!current_allocator, "Only one frame allocator can exist at a time");
+    current_allocator = this;
+
+    GLint uniform_alignment = 0;
+    GLint storage_alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+    _uniform_alignment = size_t(std::max(uniform_alignment, 1));
+    _storage_alignment = size_t(std::max(storage_alignment, 1));
+
+    _handle = GLHandle(create_mapped_buffer(_frame_size * frames_in_flight, _mapping));
+}
+
+FrameAllocator::~FrameAllocator() {
+    for(u32 i = 0; i != frames_in_flight; ++i) {
+        release_frame(i);
+    }
+    delete_mapped_buffer(_handle.get());
+    current_allocator = nullptr;
+}
+
+FrameAllocator& FrameAllocator::current() {
+    ALWAYS_ASSERT(current_allocator, "No frame allocator");
+    return *current_allocator;
+}
+
+void FrameAllocator::begin_frame() {
+    const size_t required_size = _head + _overflow_size;
+    _last_frame_size = required_size;
+    _head = 0;
+    _overflow_size = 0;
+
+    // The last frame didn't fit: grow once every frame in flight is done with the old buffer
+    if(required_size > _frame_size) {
+        for(u32 i = 0; i != frames_in_flight; ++i) {
+            release_frame(i);
+        }
+        delete_mapped_buffer(_handle.get());
+
+        while(_frame_size < required_size) {
+            _frame_size *= 2;
+        }
+        _handle = GLHandle(create_mapped_buffer(_frame_size * frames_in_flight, _mapping));
+        std::cout << "Frame allocator grown to " << (_frame_size / 1024) << "KB per frame" << std::endl;
+        return;
+    }
+
+    release_frame(_frame);
+}
+
+void FrameAllocator::end_frame() {
+    DEBUG_ASSERT(!_fences[_frame]);
+    _fences[_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _frame = (_frame + 1) % frames_in_flight;
+}
+
+TransientRange FrameAllocator::allocate_bytes(size_t size, size_t alignment, BufferUsage usage) {
+    DEBUG_ASSERT(size && alignment);
+    switch(usage) {
+        case BufferUsage::Uniform:
+            alignment = std::max(alignment, _uniform_alignment);
+        break;
+
+        case BufferUsage::Storage:
+            alignment = std::max(alignment, _storage_alignment);
+        break;
+
+        default:
+        break;
+    }
+
+    TransientRange range;
+    range._size = size;
+
+    const size_t offset = align_offset(_head, alignment);
+    if(offset + size <= _frame_size) {
+        _head = offset + size;
+        range._handle = _handle.get();
+        range._offset = _frame * _frame_size + offset;
+        range._data = _mapping + range._offset;
+        return range;
+    }
+
+    // Doesn't fit in the region, this frame gets a dedicated buffer and the next ones a larger region
+    byte* mapping = nullptr;
+    range._handle = create_mapped_buffer(size, mapping);
+    range._data = mapping;
+    _overflow_buffers[_frame].push_back(range._handle);
+    _overflow_size += size + alignment;
+    return range;
+}
+
+u32 FrameAllocator::frame_index() const {
+    return _frame;
+}
+
+size_t FrameAllocator::frame_byte_size() const {
+    return _frame_size;
+}
+
+size_t FrameAllocator::last_frame_byte_size() const {
+    return _last_frame_size;
+}
+
+void FrameAllocator::release_frame(u32 frame) {
+    if(GLsync fence = static_cast<GLsync>(_fences[frame])) {
+        wait_fence(fence);
+        glDeleteSync(fence);
+        _fences[frame] = nullptr;
+    }
+
+    for(const u32 handle : _overflow_buffers[frame]) {
+        delete_mapped_buffer(handle);
+    }
+    _overflow_buffers[frame].clear();
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef FRAMEALLOCATOR_H
+#define FRAMEALLOCATOR_H
+
+#include <graphics.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace OM3D {
+
+// Range of the frame allocator's buffer, only valid until the end of the frame it was allocated in
+class TransientRange {
+    public:
+        // Binds the whole buffer, draws have to add byte_offset() to their offsets
+        void bind(BufferUsage usage) const;
+        // Binds only the range
+        void bind(BufferUsage usage, u32 index) const;
+
+        size_t byte_offset() const;
+        size_t byte_size() const;
+
+    protected:
+        friend class FrameAllocator;
+
+        u32 _handle = 0;
+        size_t _offset = 0;
+        size_t _size = 0;
+        void* _data = nullptr;
+};
+
+template<typename T>
+class TransientBuffer : public TransientRange {
+    public:
+        // Mapped write-combined memory: write it, don't read it
+        T* data() const {
+            return static_cast<T*>(_data);
+        }
+
+        size_t element_count() const {
+            return _size / sizeof(T);
+        }
+
+        T& operator[](size_t index) const {
+            DEBUG_ASSERT(index < element_count());
+            return data()[index];
+        }
+};
+
+// Hands out ranges of a persistently mapped buffer for data written by the CPU and read once by the GPU.
+// The buffer holds one region per frame in flight, a region is reused once the fence of its last frame is signaled
+class FrameAllocator : NonMovable {
+    public:
+        static constexpr u32 frames_in_flight = 3;
+
+        FrameAllocator(size_t frame_byte_size = 8 * 1024 * 1024);
+        ~FrameAllocator();
+
+        // The allocator of the render loop, there can only be one at a time
+        static FrameAllocator& current();
+
+        // Waits until the GPU is done with this frame's region
+        void begin_frame();
+        // Fences the commands of the frame, its ranges can't be used afterwards
+        void end_frame();
+
+        // Ranges are never empty, so that they can always be bound
+        template<typename T>
+        TransientBuffer<T> allocate(size_t count, BufferUsage usage) {
+            TransientBuffer<T> buffer;
+            static_cast<TransientRange&>(buffer) = allocate_bytes(std::max(count, size_t(1)) * sizeof(T), alignof(T), usage);
+            return buffer;
+        }
+
+        TransientRange allocate_bytes(size_t size, size_t alignment, BufferUsage usage);
+
+        // Region of the current frame, resources used by a single frame can be indexed with it
+        u32 frame_index() const;
+
+        size_t frame_byte_size() const;
+        // Bytes allocated by the previous frame, including the ones that didn't fit in its region
+        size_t last_frame_byte_size() const;
+
+    private:
+        // Waits for the fence of a frame and frees its overflow buffers
+        void release_frame(u32 frame);
+
+        GLHandle _handle;
+        byte* _mapping = nullptr;
+        size_t _frame_size = 0;
+
+        // GLsync of the last commands of each frame
+        std::array<void*, frames_in_flight> _fences = {};
+
+        // Buffers of the allocations that didn't fit, kept until their frame is done
+        std::array<std::vector<u32>, frames_in_flight> _overflow_buffers;
+
+        u32 _frame = 0;
+        size_t _head = 0;
+        size_t _overflow_size = 0;
+        size_t _last_frame_size = 0;
+
+        size_t _uniform_alignment = 0;
+        size_t _storage_alignment = 0;
+};
+
+}
+
+#endif // FRAMEALLOCATOR_H
@@ -0,0 +1,269 @@
+#include "FrustumCulling.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OM3D_CULLING_SSE
+#include <immintrin.h>
+
+// Wider kernels are compiled for their instruction set regardless of the build flags, and only called if the CPU has it
+#if defined(__GNUC__) || defined(__clang__)
+#define OM3D_CULLING_AVX
+#define OM3D_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER)
+#define OM3D_CULLING_AVX
+#define OM3D_TARGET(isa)
+#include <intrin.h>
+#endif
+#endif
+
+namespace OM3D {
+
+size_t BoundingSpheres::size() const {
+    return radius.size();
+}
+
+void BoundingSpheres::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
+
+void BoundingSpheres::resize(size_t size) {
+    x.resize(size);
+    y.resize(size);
+    z.resize(size);
+    radius.resize(size);
+}
+
+void BoundingSpheres::set(size_t index, const glm::vec3& center, float r) {
+    x[index] = center.x;
+    y[index] = center.y;
+    z[index] = center.z;
+    radius[index] = r;
+}
+
+void BoundingSpheres::push_back(const glm::vec3& center, float r) {
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    radius.push_back(r);
+}
+
+static constexpr u32 plane_count = 5;
+
+// A sphere is visible if dot(center, normal) + radius >= offset for every plane
+struct CullingPlanes {
+    float nx[plane_count];
+    float ny[plane_count];
+    float nz[plane_count];
+    float offset[plane_count];
+};
+
+static CullingPlanes build_planes(const Frustum& frustum, const glm::vec3& camera_position) {
+    const glm::vec3 normals[plane_count] = {frustum._near_normal, frustum._top_normal, frustum._bottom_normal, frustum._right_normal, frustum._left_normal};
+
+    CullingPlanes planes = {};
+    for(u32 i = 0; i != plane_count; ++i) {
+        planes.nx[i] = normals[i].x;
+        planes.ny[i] = normals[i].y;
+        planes.nz[i] = normals[i].z;
+        planes.offset[i] = glm::dot(camera_position, normals[i]);
+    }
+    return planes;
+}
+
+// Kernels handle the spheres in [first, end) and return the number of indices written to `out`
+static size_t cull_scalar(const CullingPlanes& planes, const BoundingSpheres& spheres, size_t first, size_t end, u32* out) {
+    size_t written = 0;
+    for(size_t i = first; i != end; ++i) {
+        bool visible = true;
+        for(u32 p = 0; p != plane_count; ++p) {
+            const float distance = spheres.x[i] * planes.nx[p] + spheres.y[i] * planes.ny[p] + spheres.z[i] * planes.nz[p];
+            visible &= distance + spheres.radius[i] >= planes.offset[p];
+        }
+        // Branchless compaction: the index is always written, but only kept if visible
+        out[written] = u32(i);
+        written += visible;
+    }
+    return written;
+}
+
+#ifdef OM3D_CULLING_SSE
+static size_t cull_sse2(const CullingPlanes& planes, const BoundingSpheres& spheres, size_t first, size_t end, u32* out) {
+    size_t written = 0;
+    size_t i = first;
+    for(; i + 4 <= end; i += 4) {
+        const __m128 x = _mm_loadu_ps(spheres.x.data() + i);
+        const __m128 y = _mm_loadu_ps(spheres.y.data() + i);
+        const __m128 z = _mm_loadu_ps(spheres.z.data() + i);
+        const __m128 r = _mm_loadu_ps(spheres.radius.data() + i);
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(u32 p = 0; p != plane_count; ++p) {
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes.nx[p])), _mm_mul_ps(y, _mm_set1_ps(planes.ny[p]))), _mm_mul_ps(z, _mm_set1_ps(planes.nz[p])));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, r), _mm_set1_ps(planes.offset[p])));
+        }
+
+        const u32 mask = u32(_mm_movemask_ps(visible));
+        for(u32 k = 0; k != 4; ++k) {
+            out[written] = u32(i + k);
+            written += (mask >> k) & 1;
+        }
+    }
+    return written + cull_scalar(planes, spheres, i, end, out + written);
+}
+#endif
+
+#ifdef OM3D_CULLING_AVX
+static size_t count_bits(u32 bits) {
+    size_t count = 0;
+    for(; bits; bits &= bits - 1) {
+        ++count;
+    }
+    return count;
+}
+
+OM3D_TARGET("avx2")
+static size_t cull_avx2(const CullingPlanes& planes, const BoundingSpheres& spheres, size_t first, size_t end, u32* out) {
+    size_t written = 0;
+    size_t i = first;
+    for(; i + 8 <= end; i += 8) {
+        const __m256 x = _mm256_loadu_ps(spheres.x.data() + i);
+        const __m256 y = _mm256_loadu_ps(spheres.y.data() + i);
+        const __m256 z = _mm256_loadu_ps(spheres.z.data() + i);
+        const __m256 r = _mm256_loadu_ps(spheres.radius.data() + i);
+
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(u32 p = 0; p != plane_count; ++p) {
+            const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(planes.nx[p])), _mm256_mul_ps(y, _mm256_set1_ps(planes.ny[p]))), _mm256_mul_ps(z, _mm256_set1_ps(planes.nz[p])));
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distance, r), _mm256_set1_ps(planes.offset[p]), _CMP_GE_OQ));
+        }
+
+        const u32 mask = u32(_mm256_movemask_ps(visible));
+        for(u32 k = 0; k != 8; ++k) {
+            out[written] = u32(i + k);
+            written += (mask >> k) & 1;
+        }
+    }
+    return written + cull_scalar(planes, spheres, i, end, out + written);
+}
+
+OM3D_TARGET("avx512f")
+static size_t cull_avx512(const CullingPlanes& planes, const BoundingSpheres& spheres, size_t first, size_t end, u32* out) {
+    size_t written = 0;
+    size_t i = first;
+    for(; i + 16 <= end; i += 16) {
+        const __m512 x = _mm512_loadu_ps(spheres.x.data() + i);
+        const __m512 y = _mm512_loadu_ps(spheres.y.data() + i);
+        const __m512 z = _mm512_loadu_ps(spheres.z.data() + i);
+        const __m512 r = _mm512_loadu_ps(spheres.radius.data() + i);
+
+        __mmask16 visible = 0xFFFF;
+        for(u32 p = 0; p != plane_count; ++p) {
+            const __m512 distance = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(planes.nx[p])), _mm512_mul_ps(y, _mm512_set1_ps(planes.ny[p]))), _mm512_mul_ps(z, _mm512_set1_ps(planes.nz[p])));
+            visible = _mm512_mask_cmp_ps_mask(visible, _mm512_add_ps(distance, r), _mm512_set1_ps(planes.offset[p]), _CMP_GE_OQ);
+        }
+
+        // Compress store writes the visible indices contiguously
+        const __m512i indices = _mm512_add_epi32(_mm512_set1_epi32(int(i)), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        _mm512_mask_compressstoreu_epi32(out + written, visible, indices);
+        written += count_bits(visible);
+    }
+    return written + cull_scalar(planes, spheres, i, end, out + written);
+}
+#endif
+
+static SimdLevel detect_simd_level() {
+#if defined(OM3D_CULLING_AVX) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::AVX512;
+    }
+    if(__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+#elif defined(OM3D_CULLING_AVX)
+    int info[4] = {};
+    __cpuid(info, 1);
+    const bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x06) == 0x06;
+    const bool os_saves_zmm = os_saves_ymm && (_xgetbv(0) & 0xE6) == 0xE6;
+    __cpuidex(info, 7, 0);
+    if(os_saves_zmm && (info[1] & (1 << 16))) {
+        return SimdLevel::AVX512;
+    }
+    if(os_saves_ymm && (info[1] & (1 << 5))) {
+        return SimdLevel::AVX2;
+    }
+#endif
+
+#ifdef OM3D_CULLING_SSE
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel best_simd_level() {
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch(level) {
+        case SimdLevel::Scalar:
+            return "scalar";
+        case SimdLevel::SSE2:
+            return "SSE2";
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::AVX512:
+            return "AVX-512";
+    }
+    return "unknown";
+}
+
+static size_t run_kernel(SimdLevel level, const CullingPlanes& planes, const BoundingSpheres& spheres, size_t first, size_t end, u32* out) {
+    switch(level) {
+#ifdef OM3D_CULLING_AVX
+        case SimdLevel::AVX512:
+            return cull_avx512(planes, spheres, first, end, out);
+
+        case SimdLevel::AVX2:
+            return cull_avx2(planes, spheres, first, end, out);
+#endif
+
+#ifdef OM3D_CULLING_SSE
+        case SimdLevel::SSE2:
+            return cull_sse2(planes, spheres, first, end, out);
+#endif
+
+        default:
+            return cull_scalar(planes, spheres, first, end, out);
+    }
+}
+
+void cull_spheres(const Frustum& frustum, const glm::vec3& camera_position, const BoundingSpheres& spheres, std::vector<u32>& visible, SimdLevel level) {
+    cull_spheres(frustum, camera_position, spheres, 0, spheres.size(), visible, level);
+}
+
+void cull_spheres(const Frustum& frustum, const glm::vec3& camera_position, const BoundingSpheres& spheres, size_t first, size_t count, std::vector<u32>& visible, SimdLevel level) {
+    DEBUG_ASSERT(first + count <= spheres.size());
+    if(!count) {
+        return;
+    }
+
+    const CullingPlanes planes = build_planes(frustum, camera_position);
+
+    // Room for every index, trimmed once the visible ones are known
+    const size_t offset = visible.size();
+    visible.resize(offset + count);
+
+    const size_t written = run_kernel(std::min(level, best_simd_level()), planes, spheres, first, first + count, visible.data() + offset);
+    visible.resize(offset + written);
+}
+
+}
@@ -0,0 +1,45 @@
+#ifndef FRUSTUMCULLING_H
+#define FRUSTUMCULLING_H
+
+#include <Camera.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// World space bounding spheres as a structure of arrays, for the culling kernels
+struct BoundingSpheres {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    size_t size() const;
+    void clear();
+    void resize(size_t size);
+    void set(size_t index, const glm::vec3& center, float r);
+    void push_back(const glm::vec3& center, float r);
+};
+
+// Instruction sets the culling kernels are compiled for, picked at runtime
+enum class SimdLevel {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512,
+};
+
+// Best level supported by both the build and the CPU
+SimdLevel best_simd_level();
+const char* simd_level_name(SimdLevel level);
+
+// Appends the indices of the spheres that are at least partially in the frustum to `visible`.
+// Uses the same plane test as Camera::in_frustum, `level` above best_simd_level() falls back to the best one
+void cull_spheres(const Frustum& frustum, const glm::vec3& camera_position, const BoundingSpheres& spheres, std::vector<u32>& visible, SimdLevel level = best_simd_level());
+
+// Same for the spheres in [first; first + count), indices are still relative to the whole array
+void cull_spheres(const Frustum& frustum, const glm::vec3& camera_position, const BoundingSpheres& spheres, size_t first, size_t count, std::vector<u32>& visible, SimdLevel level = best_simd_level());
+
+}
+
+#endif // FRUSTUMCULLING_H
@@ -0,0 +1,208 @@
+#include "GPUScene.h"
+
+#include <glad/glad.h>
+
+#include <map>
+
+namespace OM3D {
+
+static u32 next_power_of_two(u32 x) {
+    u32 power = 1;
+    while(power < x) {
+        power *= 2;
+    }
+    return power;
+}
+
+GPUScene::GPUScene(Span<const SceneObject> objects) :
+    _object_count(u32(objects.size())),
+    _cull_program(Program::from_file("cull.comp")),
+    _pyramid_program(Program::from_file("depth_pyramid.comp")) {
+
+    if(objects.is_empty()) {
+        return;
+    }
+
+    // Ordered by material first, so that consecutive draws share their material
+    std::map<std::pair<const Material*, const StaticMesh*>, std::vector<u32>> group_objects;
+    for(size_t i = 0; i != objects.size(); ++i) {
+        group_objects[{objects[i].get_material().get(), objects[i].get_mesh().get()}].push_back(u32(i));
+    }
+
+    std::vector<shader::Model> transforms(objects.size());
+    std::vector<shader::CullObject> cull_objects(objects.size());
+    std::vector<shader::DrawGroup> groups;
+    std::vector<float> lod_errors;
+    std::vector<DrawElementsIndirectCommand> commands;
+    u32 instance_count = 0;
+
+    for(const auto& [key, indices] : group_objects) {
+        const u32 group_index = u32(_groups.size());
+
+        DrawGroup& group = _groups.emplace_back();
+        group.material = objects[indices[0]].get_material();
+        group.mesh = objects[indices[0]].get_mesh();
+        group.first_command = u32(commands.size());
+        group.lod_count = u32(group.mesh->lods().size());
+        groups.push_back({group.first_command, group.lod_count});
+
+        for(const MeshLod& lod : group.mesh->lods()) {
+            commands.push_back({lod.index_count, 0, lod.first_index, 0, instance_count});
+            lod_errors.push_back(lod.error);
+            instance_count += u32(indices.size());
+        }
+
+        for(const u32 i : indices) {
+            const SceneObject& obj = objects[i];
+            const BoundingSphere sphere = obj.world_sphere();
+            const CenteredBox box = obj.world_box();
+            transforms[i] = {obj.transform()};
+            cull_objects[i] = {sphere.center, sphere.radius, box.center, group_index, box.extents, max_scale(obj.transform())};
+        }
+    }
+
+    _transforms = TypedBuffer<shader::Model>(transforms);
+    _objects = TypedBuffer<shader::CullObject>(cull_objects);
+    _group_buffer = TypedBuffer<shader::DrawGroup>(groups);
+    _lod_errors = TypedBuffer<float>(lod_errors);
+    _empty_commands = TypedBuffer<DrawElementsIndirectCommand>(commands);
+    for(size_t pass = 0; pass != 2; ++pass) {
+        _commands[pass] = TypedBuffer<DrawElementsIndirectCommand>(commands);
+        _instance_offsets[pass] = TypedBuffer<u32>(nullptr, instance_count);
+    }
+    _occlusion_flags = TypedBuffer<u32>(nullptr, objects.size());
+
+    // Bound even without occlusion culling, until the first pyramid is built
+    const float no_pyramid = 0.0f;
+    _pyramid = TypedBuffer<float>(&no_pyramid, 1);
+
+    const std::array<u32, 2> no_stats = {};
+    for(auto& stats : _stats) {
+        stats = TypedBuffer<u32>(no_stats);
+    }
+}
+
+GPUSceneStats GPUScene::render(const Camera& camera, float lod_pixel_error, float viewport_height, const Texture* depth) const {
+    GPUSceneStats stats;
+    if(_groups.empty()) {
+        return stats;
+    }
+
+    // The frame allocator waited for the frame that last used these stats
+    {
+        auto mapping = _stats[FrameAllocator::current().frame_index()].map(AccessType::ReadWrite);
+        if(++_frames_rendered > FrameAllocator::frames_in_flight) {
+            stats.objects_visible = mapping[0];
+            stats.objects_occluded = mapping[1];
+        }
+        mapping[0] = 0;
+        mapping[1] = 0;
+    }
+
+    if(depth) {
+        resize_pyramid(depth->size());
+    } else {
+        // Frames rendered without occlusion culling don't update the pyramid
+        _has_pyramid = false;
+    }
+
+    const auto first_pass = culling_data(camera, lod_pixel_error, viewport_height);
+    first_pass[0].occlusion_pass = _has_pyramid ? 1 : 0;
+    first_pass[0].occlusion_view_proj = _pyramid_view_proj;
+    cull_and_draw(first_pass, 0);
+    stats.multi_draws = _groups.size();
+
+    if(!depth) {
+        return stats;
+    }
+
+    const auto second_pass = culling_data(camera, lod_pixel_error, viewport_height);
+    second_pass[0].occlusion_pass = 2;
+    second_pass[0].occlusion_view_proj = camera.view_proj_matrix();
+
+    // Builds the pyramid from what the first pass drew, and the objects it occluded are tested against it
+    second_pass.bind(BufferUsage::Uniform, 1);
+    depth->bind(0);
+    _pyramid.bind(BufferUsage::Storage, 8);
+    _pyramid_program->bind();
+    glDispatchCompute((_pyramid_size.x + 31) / 32, (_pyramid_size.y + 31) / 32, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    cull_and_draw(second_pass, 1);
+    stats.multi_draws += _groups.size();
+
+    _pyramid_view_proj = camera.view_proj_matrix();
+    _has_pyramid = true;
+
+    return stats;
+}
+
+TransientBuffer<shader::CullingData> GPUScene::culling_data(const Camera& camera, float lod_pixel_error, float viewport_height) const {
+    const Frustum frustum = camera.build_frustum();
+    const glm::vec3 normals[] = {frustum._near_normal, frustum._top_normal, frustum._bottom_normal, frustum._right_normal, frustum._left_normal};
+
+    const auto culling = FrameAllocator::current().allocate<shader::CullingData>(1, BufferUsage::Uniform);
+    for(size_t i = 0; i != std::size(normals); ++i) {
+        culling[0].planes[i] = glm::vec4(normals[i], glm::dot(normals[i], camera.position()));
+    }
+    culling[0].camera_position = camera.position();
+    culling[0].object_count = _object_count;
+    culling[0].lod_pixel_scale = camera.projection_matrix()[1][1] * viewport_height * 0.5f;
+    culling[0].lod_pixel_error = lod_pixel_error;
+    culling[0].occlusion_pass = 0;
+    culling[0].pyramid_levels = _pyramid_levels;
+    culling[0].occlusion_view_proj = glm::mat4(1.0f);
+    culling[0].viewport_size = _viewport_size;
+    culling[0].pyramid_size = _pyramid_size;
+    return culling;
+}
+
+// Level 0 is half the viewport, rounded up to powers of two so that every level exactly halves the previous one
+void GPUScene::resize_pyramid(const glm::uvec2& viewport_size) const {
+    if(viewport_size == _viewport_size) {
+        return;
+    }
+
+    _viewport_size = viewport_size;
+    _pyramid_size = glm::uvec2(next_power_of_two((viewport_size.x + 1) / 2), next_power_of_two((viewport_size.y + 1) / 2));
+    _pyramid_levels = Texture::mip_levels(_pyramid_size);
+
+    // The first float holds the counter of groups done, which has to start at 0
+    size_t size = 1;
+    for(u32 level = 0; level != _pyramid_levels; ++level) {
+        const glm::uvec2 level_size = glm::max(_pyramid_size >> level, glm::uvec2(1));
+        size += size_t(level_size.x) * level_size.y;
+    }
+    const std::vector<float> zeros(size, 0.0f);
+    _pyramid = TypedBuffer<float>(zeros);
+    _has_pyramid = false;
+}
+
+void GPUScene::cull_and_draw(const TransientBuffer<shader::CullingData>& culling, u32 pass) const {
+    _empty_commands.copy_to(_commands[pass]);
+
+    culling.bind(BufferUsage::Uniform, 1);
+    _objects.bind(BufferUsage::Storage, 3);
+    _group_buffer.bind(BufferUsage::Storage, 4);
+    _lod_errors.bind(BufferUsage::Storage, 5);
+    _commands[pass].bind(BufferUsage::Storage, 6);
+    _instance_offsets[pass].bind(BufferUsage::Storage, 7);
+    _pyramid.bind(BufferUsage::Storage, 8);
+    _occlusion_flags.bind(BufferUsage::Storage, 9);
+    _stats[FrameAllocator::current().frame_index()].bind(BufferUsage::Storage, 10);
+
+    _cull_program->bind();
+    glDispatchCompute((_object_count + 63) / 64, 1, 1);
+
+    // The draws read the commands as indirect arguments and the offsets as a vertex attribute,
+    // and the stats counted with atomics are read back through map() once the frame is done
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    _transforms.bind(BufferUsage::Storage, 2);
+    for(const DrawGroup& group : _groups) {
+        group.material->bind();
+        group.mesh->draw_indirect(_commands[pass], group.first_command, group.lod_count, _instance_offsets[pass]);
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+#ifndef GPUSCENE_H
+#define GPUSCENE_H
+
+#include <SceneObject.h>
+#include <TypedBuffer.h>
+#include <FrameAllocator.h>
+#include <Texture.h>
+
+#include <shader_structs.h>
+
+#include <array>
+#include <vector>
+#include <memory>
+
+namespace OM3D {
+
+struct GPUSceneStats {
+    size_t multi_draws = 0;
+    // Read back a few frames late so that the CPU never waits for the GPU, 0 until then
+    size_t objects_visible = 0;
+    size_t objects_occluded = 0;
+};
+
+// Copy of the scene objects in GPU buffers, culled and LOD selected by a compute shader that writes the draw commands.
+// Each (material, mesh) pair is drawn with one multi draw indirect, so the CPU cost doesn't depend on the object count
+class GPUScene : NonCopyable {
+
+    public:
+        GPUScene(Span<const SceneObject> objects);
+
+        // Culls every object and draws the visible ones. A `lod_pixel_error` of 0 keeps every object at LOD 0.
+        // With the depth attachment being rendered to, objects are also occlusion culled in two passes:
+        // the first draws what the previous frame's depth pyramid doesn't hide, then the pyramid is rebuilt
+        // from the new depth and the second draws the objects it disoccluded
+        GPUSceneStats render(const Camera& camera, float lod_pixel_error, float viewport_height, const Texture* depth = nullptr) const;
+
+    private:
+        TransientBuffer<shader::CullingData> culling_data(const Camera& camera, float lod_pixel_error, float viewport_height) const;
+        void resize_pyramid(const glm::uvec2& viewport_size) const;
+        void cull_and_draw(const TransientBuffer<shader::CullingData>& culling, u32 pass) const;
+
+        struct DrawGroup {
+            std::shared_ptr<Material> material;
+            std::shared_ptr<StaticMesh> mesh;
+            u32 first_command = 0;
+            u32 lod_count = 0;
+        };
+
+        std::vector<DrawGroup> _groups;
+        u32 _object_count = 0;
+
+        TypedBuffer<shader::Model> _transforms;
+        TypedBuffer<shader::CullObject> _objects;
+        TypedBuffer<shader::DrawGroup> _group_buffer;
+        TypedBuffer<float> _lod_errors;
+
+        // Commands with no instance, copied over the culled ones before each dispatch
+        TypedBuffer<DrawElementsIndirectCommand> _empty_commands;
+
+        // One set per culling pass. Offsets have room for every object of a group in each of its LODs' commands
+        mutable std::array<TypedBuffer<DrawElementsIndirectCommand>, 2> _commands;
+        std::array<TypedBuffer<u32>, 2> _instance_offsets;
+
+        TypedBuffer<u32> _occlusion_flags;
+        mutable std::array<TypedBuffer<u32>, FrameAllocator::frames_in_flight> _stats;
+        mutable size_t _frames_rendered = 0;
+
+        mutable TypedBuffer<float> _pyramid;
+        mutable glm::uvec2 _viewport_size = {};
+        mutable glm::uvec2 _pyramid_size = {};
+        mutable u32 _pyramid_levels = 0;
+        // View projection of the frame that built the pyramid, invalid until then
+        mutable glm::mat4 _pyramid_view_proj = {};
+        mutable bool _has_pyramid = false;
+
+        std::shared_ptr<Program> _cull_program;
+        std::shared_ptr<Program> _pyramid_program;
+};
+
+}
+
+#endif // GPUSCENE_H
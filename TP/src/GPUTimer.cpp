@@ -0,0 +1,34 @@
+#include "GPUTimer.h"
+
+#include <glad/glad.h>
+
+namespace OM3D {
+
+GPUTimer::GPUTimer() {
+    glCreateQueries(GL_TIME_ELAPSED, GLsizei(_queries.size()), _queries.data());
+}
+
+GPUTimer::~GPUTimer() {
+    glDeleteQueries(GLsizei(_queries.size()), _queries.data());
+}
+
+void GPUTimer::begin() {
+    const u32 index = FrameAllocator::current().frame_index();
+    if(_pending[index]) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(_queries[index], GL_QUERY_RESULT, &nanoseconds);
+        _last_ms = double(nanoseconds) / 1'000'000.0;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, _queries[index]);
+}
+
+void GPUTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    _pending[FrameAllocator::current().frame_index()] = true;
+}
+
+double GPUTimer::last_ms() const {
+    return _last_ms;
+}
+
+}
@@ -0,0 +1,32 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <FrameAllocator.h>
+
+#include <array>
+
+namespace OM3D {
+
+// Measures the GPU time of the commands between begin() and end(), with one query per frame in flight.
+// A query is read once the frame allocator has waited for its frame, so reading never stalls
+class GPUTimer : NonMovable {
+    public:
+        GPUTimer();
+        ~GPUTimer();
+
+        // Timers can't be nested or overlap
+        void begin();
+        void end();
+
+        // Last measurement that completed, 0 until then. Kept when the timer stops being used
+        double last_ms() const;
+
+    private:
+        std::array<u32, FrameAllocator::frames_in_flight> _queries = {};
+        std::array<bool, FrameAllocator::frames_in_flight> _pending = {};
+        double _last_ms = 0.0;
+};
+
+}
+
+#endif // GPUTIMER_H
@@ -1,6 +1,6 @@
 #include "ImGuiRenderer.h"
 
-#include <TypedBuffer.h>
+#include <FrameAllocator.h>
 
 #include <glm/vec2.hpp>
 
@@ -244,19 +244,16 @@ void ImGuiRenderer::render(const ImDrawData* draw_data) {
     glEnable(GL_SCISSOR_TEST);
     DEFER(glDisable(GL_SCISSOR_TEST));
 
-    TypedBuffer<ImDrawIdx> index_buffer(nullptr, draw_data->TotalIdxCount);
-    TypedBuffer<ImDrawVert> vertex_buffer(nullptr, draw_data->TotalVtxCount);
+    const auto index_buffer = FrameAllocator::current().allocate<ImDrawIdx>(draw_data->TotalIdxCount, BufferUsage::Index);
+    const auto vertex_buffer = FrameAllocator::current().allocate<ImDrawVert>(draw_data->TotalVtxCount, BufferUsage::Attribute);
 
     {
-        auto indices = index_buffer.map(AccessType::WriteOnly);
-        auto vertices = vertex_buffer.map(AccessType::WriteOnly);
-
         size_t index_offset = 0;
         size_t vertex_offset = 0;
         for(int c = 0; c != draw_data->CmdListsCount; ++c) {
             const ImDrawList* cmd_list = draw_data->CmdLists[c];
-            std::copy_n(cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size, &indices[index_offset]);
-            std::copy_n(cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size, &vertices[vertex_offset]);
+            std::copy_n(cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size, index_buffer.data() + index_offset);
+            std::copy_n(cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size, vertex_buffer.data() + vertex_offset);
             vertex_offset += cmd_list->VtxBuffer.Size;
             index_offset += cmd_list->IdxBuffer.Size;
         }
@@ -265,8 +262,9 @@ void ImGuiRenderer::render(const ImDrawData* draw_data) {
     index_buffer.bind(BufferUsage::Index);
     vertex_buffer.bind(BufferUsage::Attribute);
 
-    byte* vertex_offset = nullptr;
-    byte* index_offset = nullptr;
+    // Ranges start somewhere in the frame allocator's buffer
+    byte* vertex_offset = reinterpret_cast<byte*>(vertex_buffer.byte_offset());
+    byte* index_offset = reinterpret_cast<byte*>(index_buffer.byte_offset());
     for(int c = 0; c != draw_data->CmdListsCount; ++c) {
         const ImDrawList* cmd_list = draw_data->CmdLists[c];
 
@@ -2,6 +2,22 @@
 
 #include <glad/glad.h>
 
+#include <algorithm>
+
+// From EXT_texture_compression_s3tc and EXT_texture_sRGB, which are not part of core OpenGL
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
 namespace OM3D {
 
 ImageFormatGL image_format_to_gl(ImageFormat format) {
@@ -12,9 +28,70 @@ ImageFormatGL image_format_to_gl(ImageFormat format) {
         case ImageFormat::RGB8_sRGB:        return ImageFormatGL{ GL_RGB, GL_SRGB8, GL_UNSIGNED_BYTE };
         case ImageFormat::RGBA16_FLOAT:     return ImageFormatGL{ GL_RGBA, GL_RGBA16F, GL_FLOAT };
         case ImageFormat::Depth32_FLOAT:    return ImageFormatGL{ GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT32F, GL_FLOAT };
+
+        case ImageFormat::BC1_UNORM:        return ImageFormatGL{ GL_RGB, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_UNSIGNED_BYTE };
+        case ImageFormat::BC1_sRGB:         return ImageFormatGL{ GL_RGB, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, GL_UNSIGNED_BYTE };
+        case ImageFormat::BC3_UNORM:        return ImageFormatGL{ GL_RGBA, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_UNSIGNED_BYTE };
+        case ImageFormat::BC3_sRGB:         return ImageFormatGL{ GL_RGBA, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, GL_UNSIGNED_BYTE };
+        case ImageFormat::BC5_UNORM:        return ImageFormatGL{ GL_RG, GL_COMPRESSED_RG_RGTC2, GL_UNSIGNED_BYTE };
     }
 
     FATAL("Unknown image format");
 }
 
+bool is_block_compressed(ImageFormat format) {
+    switch(format) {
+        case ImageFormat::BC1_UNORM:
+        case ImageFormat::BC1_sRGB:
+        case ImageFormat::BC3_UNORM:
+        case ImageFormat::BC3_sRGB:
+        case ImageFormat::BC5_UNORM:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+glm::uvec2 mip_size(const glm::uvec2& size, u32 level) {
+    return glm::uvec2(std::max(size.x >> level, 1u), std::max(size.y >> level, 1u));
+}
+
+static size_t level_byte_size(ImageFormat format, const glm::uvec2& size) {
+    const size_t pixels = size_t(size.x) * size_t(size.y);
+    const size_t blocks = size_t((size.x + 3) / 4) * size_t((size.y + 3) / 4);
+    switch(format) {
+        case ImageFormat::RGBA8_UNORM:
+        case ImageFormat::RGBA8_sRGB:
+        case ImageFormat::Depth32_FLOAT:
+            return pixels * 4;
+
+        case ImageFormat::RGB8_UNORM:
+        case ImageFormat::RGB8_sRGB:
+            return pixels * 3;
+
+        case ImageFormat::RGBA16_FLOAT:
+            return pixels * 8;
+
+        case ImageFormat::BC1_UNORM:
+        case ImageFormat::BC1_sRGB:
+            return blocks * 8;
+
+        case ImageFormat::BC3_UNORM:
+        case ImageFormat::BC3_sRGB:
+        case ImageFormat::BC5_UNORM:
+            return blocks * 16;
+    }
+
+    FATAL("Unknown image format");
+}
+
+size_t image_byte_size(ImageFormat format, const glm::uvec2& size, u32 mip_levels) {
+    size_t bytes = 0;
+    for(u32 i = 0; i != mip_levels; ++i) {
+        bytes += level_byte_size(format, mip_size(size, i));
+    }
+    return bytes;
+}
+
 }
@@ -3,6 +3,8 @@
 
 #include <utils.h>
 
+#include <glm/vec2.hpp>
+
 namespace OM3D {
 
 enum class ImageFormat {
@@ -12,7 +14,14 @@ enum class ImageFormat {
     RGB8_sRGB,
 
     RGBA16_FLOAT,
-    Depth32_FLOAT
+    Depth32_FLOAT,
+
+    // Block compressed formats, 4x4 texels per block
+    BC1_UNORM,
+    BC1_sRGB,
+    BC3_UNORM,
+    BC3_sRGB,
+    BC5_UNORM,
 };
 
 
@@ -24,6 +33,13 @@ struct ImageFormatGL {
 
 ImageFormatGL image_format_to_gl(ImageFormat format);
 
+bool is_block_compressed(ImageFormat format);
+
+glm::uvec2 mip_size(const glm::uvec2& size, u32 level);
+
+// Size in bytes of the first mip_levels levels, tightly packed
+size_t image_byte_size(ImageFormat format, const glm::uvec2& size, u32 mip_levels = 1);
+
 }
 
 #endif // IMAGEFORMAT_H
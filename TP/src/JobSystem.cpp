@@ -0,0 +1,256 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace OM3D {
+
+struct Job {
+    std::function<void()> func;
+    JobCounter* counter = nullptr;
+};
+
+struct JobQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+};
+
+// Queue 0 is shared by the threads that aren't workers, the others belong to one worker each
+static thread_local size_t queue_index = 0;
+static thread_local bool is_worker = false;
+
+class JobSystem : NonMovable {
+    public:
+        JobSystem() {
+            const size_t worker_count = size_t(std::max(std::thread::hardware_concurrency(), 1u)) - 1;
+            for(size_t i = 0; i != worker_count + 1; ++i) {
+                _queues.push_back(std::make_unique<JobQueue>());
+            }
+            for(size_t i = 0; i != worker_count; ++i) {
+                _workers.emplace_back([this, i] { work(i + 1); });
+            }
+        }
+
+        ~JobSystem() {
+            {
+                std::lock_guard lock(_sleep_mutex);
+                _stopping = true;
+            }
+            _wake.notify_all();
+            for(std::thread& worker : _workers) {
+                worker.join();
+            }
+        }
+
+        size_t thread_count() const {
+            return _workers.size() + 1;
+        }
+
+        void push(std::function<void()> func, JobCounter& counter) {
+            ++counter._pending;
+
+            if(_workers.empty()) {
+                func();
+                --counter._pending;
+                return;
+            }
+
+            {
+                JobQueue& queue = *_queues[queue_index];
+                std::lock_guard lock(queue.mutex);
+                queue.jobs.push_back({std::move(func), &counter});
+            }
+            {
+                std::lock_guard lock(_sleep_mutex);
+                ++_queued;
+            }
+            _wake.notify_one();
+        }
+
+        void wait(JobCounter& counter) {
+            // Other threads only help with their own jobs, so that they can't pick a long job from another group
+            JobCounter* const filter = is_worker ? nullptr : &counter;
+            while(!counter.is_done()) {
+                Job job;
+                if(take(job, filter)) {
+                    run(job);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+    private:
+        void work(size_t index) {
+            queue_index = index;
+            is_worker = true;
+
+            for(;;) {
+                Job job;
+                if(take(job, nullptr)) {
+                    run(job);
+                    continue;
+                }
+
+                std::unique_lock lock(_sleep_mutex);
+                _wake.wait(lock, [this] { return _stopping || _queued > 0; });
+                if(_stopping) {
+                    return;
+                }
+            }
+        }
+
+        void run(Job& job) {
+            job.func();
+            --job.counter->_pending;
+        }
+
+        // Takes the newest job of the calling thread's queue, or steals the oldest one of another queue.
+        // If `filter` is set, only jobs of that counter are taken
+        bool take(Job& job, const JobCounter* filter) {
+            for(size_t i = 0; i != _queues.size(); ++i) {
+                const size_t index = (queue_index + i) % _queues.size();
+                JobQueue& queue = *_queues[index];
+
+                std::lock_guard lock(queue.mutex);
+                if(queue.jobs.empty()) {
+                    continue;
+                }
+
+                auto it = queue.jobs.end();
+                if(filter) {
+                    it = std::find_if(queue.jobs.begin(), queue.jobs.end(), [&](const Job& j) { return j.counter == filter; });
+                } else {
+                    it = i == 0 ? queue.jobs.end() - 1 : queue.jobs.begin();
+                }
+                if(it == queue.jobs.end()) {
+                    continue;
+                }
+
+                job = std::move(*it);
+                queue.jobs.erase(it);
+                {
+                    std::lock_guard sleep_lock(_sleep_mutex);
+                    --_queued;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        std::vector<std::unique_ptr<JobQueue>> _queues;
+        std::vector<std::thread> _workers;
+
+        std::mutex _sleep_mutex;
+        std::condition_variable _wake;
+        size_t _queued = 0;
+        bool _stopping = false;
+};
+
+static JobSystem& job_system() {
+    static JobSystem system;
+    return system;
+}
+
+bool JobCounter::is_done() const {
+    return _pending == 0;
+}
+
+void run_job(std::function<void()> func, JobCounter& counter) {
+    job_system().push(std::move(func), counter);
+}
+
+void wait_for(JobCounter& counter) {
+    job_system().wait(counter);
+}
+
+size_t job_thread_count() {
+    return job_system().thread_count();
+}
+
+void parallel_for(size_t count, const std::function<void(size_t)>& func) {
+    std::atomic<size_t> next = 0;
+    const auto worker = [&] {
+        for(size_t i = next++; i < count; i = next++) {
+            func(i);
+        }
+    };
+
+    JobCounter counter;
+    const size_t job_count = std::min(job_thread_count(), count);
+    for(size_t i = 1; i < job_count; ++i) {
+        run_job(worker, counter);
+    }
+    worker();
+    wait_for(counter);
+}
+
+size_t chunk_count(size_t count, size_t grain) {
+    // A few chunks per thread, to balance uneven chunks
+    grain = std::max(grain, size_t(1));
+    return std::min((count + grain - 1) / grain, job_thread_count() * 4);
+}
+
+void parallel_for_chunks(size_t count, size_t grain, const std::function<void(size_t, size_t, size_t)>& func) {
+    const size_t chunks = chunk_count(count, grain);
+    if(!chunks) {
+        return;
+    }
+
+    JobCounter counter;
+    for(size_t chunk = 1; chunk < chunks; ++chunk) {
+        run_job([&, chunk] {
+            func(chunk, chunk * count / chunks, (chunk + 1) * count / chunks);
+        }, counter);
+    }
+    func(0, 0, count / chunks);
+    wait_for(counter);
+}
+
+TaskGraph::TaskId TaskGraph::add(std::function<void()> func, Span<const TaskId> dependencies) {
+    const TaskId id = TaskId(_tasks.size());
+
+    Task& task = _tasks.emplace_back();
+    task.func = std::move(func);
+    task.dependency_count = u32(dependencies.size());
+    task.remaining = std::make_unique<std::atomic<u32>>(0);
+
+    for(const TaskId dependency : dependencies) {
+        ALWAYS_ASSERT(dependency < id, "Tasks can only depend on previously added tasks");
+        _tasks[dependency].dependents.push_back(id);
+    }
+
+    return id;
+}
+
+void TaskGraph::run() {
+    for(Task& task : _tasks) {
+        *task.remaining = task.dependency_count;
+    }
+
+    // The graph is acyclic as tasks only depend on previous ones: every task is eventually scheduled
+    JobCounter counter;
+    for(TaskId id = 0; id != _tasks.size(); ++id) {
+        if(!_tasks[id].dependency_count) {
+            schedule(id, counter);
+        }
+    }
+    wait_for(counter);
+}
+
+void TaskGraph::schedule(TaskId id, JobCounter& counter) {
+    run_job([this, id, &counter] {
+        const Task& task = _tasks[id];
+        task.func();
+        for(const TaskId dependent : task.dependents) {
+            if(--*_tasks[dependent].remaining == 0) {
+                schedule(dependent, counter);
+            }
+        }
+    }, counter);
+}
+
+}
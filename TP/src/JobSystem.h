@@ -0,0 +1,70 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <utils.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace OM3D {
+
+// Number of jobs of a group that aren't done yet
+class JobCounter : NonMovable {
+    public:
+        bool is_done() const;
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<size_t> _pending = 0;
+};
+
+// Queues func on the job system: a pool of worker threads where each worker runs its own jobs last in first out
+// and steals the oldest jobs of the other queues when it runs out. Jobs may queue and wait for other jobs.
+void run_job(std::function<void()> func, JobCounter& counter);
+
+// Runs jobs of the same counter on the calling thread until they are all done (worker threads run any queued job)
+void wait_for(JobCounter& counter);
+
+// Worker threads plus the calling thread
+size_t job_thread_count();
+
+// Call func(i) for every i in [0; count) using all hardware threads, returns once every call is done.
+// Indices are handed out one at a time, which balances calls that take very different amounts of time
+void parallel_for(size_t count, const std::function<void(size_t)>& func);
+
+// Number of chunks parallel_for_chunks splits `count` indices into
+size_t chunk_count(size_t count, size_t grain);
+
+// Splits [0; count) into contiguous chunks of at least `grain` indices and calls func(chunk, begin, end) for each of
+// them in parallel. Results stored per chunk and merged in chunk order are the same as a sequential loop's
+void parallel_for_chunks(size_t count, size_t grain, const std::function<void(size_t, size_t, size_t)>& func);
+
+// Tasks that run once all of their dependencies are done, independent tasks run in parallel
+class TaskGraph : NonCopyable {
+    public:
+        using TaskId = u32;
+
+        TaskId add(std::function<void()> func, Span<const TaskId> dependencies = {});
+
+        // Runs every task and returns once they are all done. The graph can be run again
+        void run();
+
+    private:
+        struct Task {
+            std::function<void()> func;
+            std::vector<TaskId> dependents;
+            u32 dependency_count = 0;
+            std::unique_ptr<std::atomic<u32>> remaining;
+        };
+
+        void schedule(TaskId task, JobCounter& counter);
+
+        std::vector<Task> _tasks;
+};
+
+}
+
+#endif // JOBSYSTEM_H
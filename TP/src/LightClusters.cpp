@@ -0,0 +1,50 @@
+#include "LightClusters.h"
+
+#include <FrameAllocator.h>
+
+#include <shader_structs.h>
+
+#include <glad/glad.h>
+
+#include <cmath>
+
+namespace OM3D {
+
+static constexpr u32 cluster_count = LightClusters::grid_width * LightClusters::grid_height * LightClusters::grid_depth;
+
+// Exponential slices between these distances, the first and last ones extend to the camera and to infinity
+static constexpr float slice_near = 0.1f;
+static constexpr float slice_far = 1000.0f;
+
+LightClusters::LightClusters() :
+    _cluster_lights(nullptr, cluster_count * (max_cluster_lights + 1)),
+    _assign_program(Program::from_file("cluster_lights.comp")) {
+}
+
+void LightClusters::build(const Camera& camera, bool enabled) const {
+    const glm::mat4& projection = camera.projection_matrix();
+
+    const auto data = FrameAllocator::current().allocate<shader::ClusterData>(1, BufferUsage::Uniform);
+    data[0].view = camera.view_matrix();
+    data[0].proj_scale = glm::vec2(projection[0][0], projection[1][1]);
+    data[0].z_near = projection[3][2];
+    data[0].enabled = enabled;
+    data[0].grid_size = glm::uvec3(grid_width, grid_height, grid_depth);
+    data[0].max_lights = max_cluster_lights;
+    data[0].slice_near = slice_near;
+    data[0].slice_scale = float(grid_depth - 2) / std::log(slice_far / slice_near);
+    data[0].padding_1 = glm::vec2(0.0f);
+
+    data.bind(BufferUsage::Uniform, 2);
+    _cluster_lights.bind(BufferUsage::Storage, 11);
+
+    if(!enabled) {
+        return;
+    }
+
+    _assign_program->bind();
+    glDispatchCompute((cluster_count + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+}
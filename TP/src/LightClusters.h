@@ -0,0 +1,37 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <Camera.h>
+#include <Program.h>
+#include <TypedBuffer.h>
+
+#include <memory>
+
+namespace OM3D {
+
+// Clustered forward shading: the view frustum is split into a grid of froxels, a compute shader assigns the lights
+// to the froxels they touch and each fragment only loops over the lights of its own
+class LightClusters : NonCopyable {
+
+    public:
+        static constexpr u32 grid_width = 16;
+        static constexpr u32 grid_height = 9;
+        static constexpr u32 grid_depth = 24;
+        static constexpr u32 max_cluster_lights = 128;
+
+        LightClusters();
+
+        // Assigns the lights of the frame data and light buffers bound at 0 and 1, then binds the clusters for the draws.
+        // When disabled, only binds what the shaders need to loop over every light instead
+        void build(const Camera& camera, bool enabled) const;
+
+    private:
+        // Count then indices, for each cluster
+        TypedBuffer<u32> _cluster_lights;
+
+        std::shared_ptr<Program> _assign_program;
+};
+
+}
+
+#endif // LIGHTCLUSTERS_H
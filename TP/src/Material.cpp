@@ -33,6 +33,14 @@ void Material::set_texture(u32 slot, std::shared_ptr<Texture> tex) {
     }
 }
 
+bool Material::culls_back_faces() const {
+    return _blend_mode == BlendMode::None;
+}
+
+bool Material::is_opaque() const {
+    return _blend_mode == BlendMode::None;
+}
+
 void Material::bind() const {
     switch(_blend_mode) {
         case BlendMode::None:
@@ -89,22 +97,33 @@ void Material::bind() const {
     _program->bind();
 }
 
-std::shared_ptr<Material> Material::material(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
+std::shared_ptr<Program> Material::pipeline_program(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) const {
+    std::vector<std::string> all_defines = _defines;
+    all_defines.insert(all_defines.end(), defines.begin(), defines.end());
+    return Program::from_files(pipeline.first, pipeline.second, all_defines);
+}
+
+void Material::set_pipeline(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
+    _program = pipeline_program(pipeline, defines);
+}
+
+std::shared_ptr<Material> Material::material(std::vector<std::string> material_defines, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
     auto material = std::make_shared<Material>();
-    material->_program = Program::from_files(pipeline.first, pipeline.second, defines);
+    material->_defines = std::move(material_defines);
+    material->set_pipeline(pipeline, defines);
     return material;
 }
 
+std::shared_ptr<Material> Material::material(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
+    return material({}, pipeline, defines);
+}
+
 std::shared_ptr<Material> Material::textured_material(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
-    std::vector<std::string> new_defines = {"TEXTURED"};
-    new_defines.insert(new_defines.end(), defines.begin(), defines.end());
-    return material(pipeline, new_defines);
+    return material({"TEXTURED"}, pipeline, defines);
 }
 
 std::shared_ptr<Material> Material::textured_normal_mapped_material(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
-    std::vector<std::string> new_defines = {"TEXTURED", "NORMAL_MAPPED"};
-    new_defines.insert(new_defines.end(), defines.begin(), defines.end());
-    return material(pipeline, new_defines);
+    return material({"TEXTURED", "NORMAL_MAPPED"}, pipeline, defines);
 }
 
 }
@@ -33,6 +33,10 @@ class Material {
         void set_depth_writing(bool enabled);
         void set_texture(u32 slot, std::shared_ptr<Texture> tex);
 
+        // Program of this material for a pipeline, with the material's own defines (TEXTURED, ...) added to `defines`
+        std::shared_ptr<Program> pipeline_program(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) const;
+        void set_pipeline(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines);
+
         template<typename... Args>
         void set_uniform(Args&&... args) {
             _program->set_uniform(FWD(args)...);
@@ -41,13 +45,21 @@ class Material {
 
         void bind() const;
 
+        // Back faces are culled for opaque materials, see bind()
+        bool culls_back_faces() const;
+        // Doesn't blend with what's behind it
+        bool is_opaque() const;
+
         static std::shared_ptr<Material> material(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines);
         static std::shared_ptr<Material> textured_material(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines);
         static std::shared_ptr<Material> textured_normal_mapped_material(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines);
 
 
     private:
+        static std::shared_ptr<Material> material(std::vector<std::string> material_defines, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines);
+
         std::shared_ptr<Program> _program;
+        std::vector<std::string> _defines;
         std::vector<std::pair<u32, std::shared_ptr<Texture>>> _textures;
 
         BlendMode _blend_mode = BlendMode::None;
@@ -0,0 +1,309 @@
+#include "MeshOptimization.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace OM3D {
+
+// FIFO cache simulation, returns the number of misses for each triangle.
+// `cache_time` and `timestamp` persist across calls so that the cache can be kept or reset (by bumping `timestamp`)
+static u32 simulate_triangle(const u32* tri, std::vector<u32>& cache_time, u32& timestamp, u32 cache_size) {
+    u32 misses = 0;
+    for(u32 k = 0; k != 3; ++k) {
+        const u32 v = tri[k];
+        if(timestamp - cache_time[v] > cache_size) {
+            cache_time[v] = timestamp++;
+            ++misses;
+        }
+    }
+    return misses;
+}
+
+VertexCacheStats analyze_vertex_cache(Span<const u32> indices, size_t vertex_count, u32 cache_size) {
+    const size_t triangle_count = indices.size() / 3;
+    if(!triangle_count) {
+        return {};
+    }
+
+    std::vector<u32> cache_time(vertex_count, 0);
+    std::vector<bool> referenced(vertex_count, false);
+    u32 timestamp = cache_size + 1;
+
+    size_t misses = 0;
+    for(size_t i = 0; i != triangle_count; ++i) {
+        misses += simulate_triangle(indices.data() + i * 3, cache_time, timestamp, cache_size);
+    }
+
+    size_t referenced_count = 0;
+    for(const u32 index : indices) {
+        if(!referenced[index]) {
+            referenced[index] = true;
+            ++referenced_count;
+        }
+    }
+
+    VertexCacheStats stats;
+    stats.acmr = float(misses) / float(triangle_count);
+    stats.atvr = float(misses) / float(referenced_count);
+    return stats;
+}
+
+
+
+static constexpr u32 forsyth_cache_size = 32;
+
+static float forsyth_vertex_score(i32 cache_position, u32 remaining_triangles) {
+    if(!remaining_triangles) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if(cache_position >= 0) {
+        // The last triangle's vertices get a fixed score so that the next triangle doesn't just reuse them
+        score = cache_position < 3
+            ? 0.75f
+            : std::pow(1.0f - float(cache_position - 3) / float(forsyth_cache_size - 3), 1.5f);
+    }
+
+    // Favor vertices with few triangles left, to finish them and avoid isolated triangles
+    return score + 2.0f / std::sqrt(float(remaining_triangles));
+}
+
+void optimize_vertex_cache(Span<u32> indices, size_t vertex_count) {
+    const size_t triangle_count = indices.size() / 3;
+    if(triangle_count < 2) {
+        return;
+    }
+
+    // Triangles of each vertex, the live ones are kept in the first `remaining[v]` slots
+    std::vector<u32> remaining(vertex_count, 0);
+    for(const u32 index : indices) {
+        ++remaining[index];
+    }
+
+    std::vector<u32> offsets(vertex_count + 1, 0);
+    std::partial_sum(remaining.begin(), remaining.end(), offsets.begin() + 1);
+
+    std::vector<u32> adjacency(triangle_count * 3);
+    {
+        std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i != triangle_count * 3; ++i) {
+            adjacency[fill[indices[i]]++] = u32(i / 3);
+        }
+    }
+
+    std::vector<i32> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for(size_t v = 0; v != vertex_count; ++v) {
+        vertex_score[v] = forsyth_vertex_score(-1, remaining[v]);
+    }
+
+    std::vector<float> triangle_score(triangle_count);
+    for(size_t t = 0; t != triangle_count; ++t) {
+        triangle_score[t] = vertex_score[indices[t * 3 + 0]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<u32> result;
+    result.reserve(triangle_count * 3);
+
+    std::vector<u32> cache;
+    std::vector<u32> new_cache;
+
+    i64 best = i64(std::max_element(triangle_score.begin(), triangle_score.end()) - triangle_score.begin());
+    size_t input_cursor = 0;
+
+    while(result.size() != triangle_count * 3) {
+        if(best < 0) {
+            // Nothing adjacent to the cache is left: restart from the first triangle not emitted yet
+            while(emitted[input_cursor]) {
+                ++input_cursor;
+            }
+            best = i64(input_cursor);
+        }
+
+        const u32 tri[] = {
+            indices[best * 3 + 0],
+            indices[best * 3 + 1],
+            indices[best * 3 + 2],
+        };
+
+        emitted[best] = true;
+        result.insert(result.end(), std::begin(tri), std::end(tri));
+
+        for(const u32 v : tri) {
+            u32* live_begin = adjacency.data() + offsets[v];
+            u32* live_end = live_begin + remaining[v];
+            std::iter_swap(std::find(live_begin, live_end, u32(best)), live_end - 1);
+            --remaining[v];
+        }
+
+        // LRU cache: the triangle's vertices go to the front
+        new_cache.assign(std::begin(tri), std::end(tri));
+        for(const u32 v : cache) {
+            if(v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache.push_back(v);
+            }
+        }
+
+        for(size_t i = 0; i != new_cache.size(); ++i) {
+            const u32 v = new_cache[i];
+            cache_position[v] = i < forsyth_cache_size ? i32(i) : -1;
+
+            const float score = forsyth_vertex_score(cache_position[v], remaining[v]);
+            const float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+
+            for(u32 j = 0; j != remaining[v]; ++j) {
+                triangle_score[adjacency[offsets[v] + j]] += delta;
+            }
+        }
+
+        new_cache.resize(std::min(new_cache.size(), size_t(forsyth_cache_size)));
+        cache.swap(new_cache);
+
+        // Only triangles using cached vertices are considered
+        best = -1;
+        float best_score = -1.0f;
+        for(const u32 v : cache) {
+            for(u32 j = 0; j != remaining[v]; ++j) {
+                const u32 t = adjacency[offsets[v] + j];
+                if(triangle_score[t] > best_score) {
+                    best = t;
+                    best_score = triangle_score[t];
+                }
+            }
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices.data());
+}
+
+
+
+struct TriangleCluster {
+    size_t begin = 0;
+    size_t end = 0;
+    float sort_key = 0.0f;
+};
+
+void optimize_overdraw(Span<u32> indices, Span<const Vertex> vertices, float threshold) {
+    const size_t triangle_count = indices.size() / 3;
+    if(triangle_count < 2) {
+        return;
+    }
+
+    const u32 cache_size = 16;
+    const float acmr_threshold = analyze_vertex_cache(indices, vertices.size(), cache_size).acmr * threshold;
+
+    std::vector<u32> cache_time(vertices.size(), 0);
+    u32 timestamp = cache_size + 1;
+
+    // Hard boundaries: triangles for which the cache is completely cold
+    std::vector<size_t> hard_boundaries = {0};
+    for(size_t t = 0; t != triangle_count; ++t) {
+        if(simulate_triangle(indices.data() + t * 3, cache_time, timestamp, cache_size) == 3 && t) {
+            hard_boundaries.push_back(t);
+        }
+    }
+    hard_boundaries.push_back(triangle_count);
+
+    // Soft boundaries: split again, starting from a cold cache, once the cluster is as cache efficient as the whole mesh
+    std::vector<TriangleCluster> clusters;
+    for(size_t i = 0; i + 1 < hard_boundaries.size(); ++i) {
+        const size_t end = hard_boundaries[i + 1];
+        size_t begin = hard_boundaries[i];
+
+        timestamp += cache_size + 1;
+        u32 cluster_misses = 0;
+        for(size_t t = begin; t != end; ++t) {
+            cluster_misses += simulate_triangle(indices.data() + t * 3, cache_time, timestamp, cache_size);
+            if(t + 1 != end && float(cluster_misses) / float(t + 1 - begin) <= acmr_threshold) {
+                clusters.push_back({begin, t + 1});
+                begin = t + 1;
+                cluster_misses = 0;
+                timestamp += cache_size + 1;
+            }
+        }
+        clusters.push_back({begin, end});
+    }
+
+    // Clusters facing away from the mesh center are drawn first, as they are likely to occlude the others
+    auto triangle_area_normal = [&](size_t t, glm::vec3& centroid) {
+        const glm::vec3& a = vertices[indices[t * 3 + 0]].position;
+        const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+        const glm::vec3& c = vertices[indices[t * 3 + 2]].position;
+        centroid = (a + b + c) / 3.0f;
+        return glm::cross(b - a, c - a);
+    };
+
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for(size_t t = 0; t != triangle_count; ++t) {
+        glm::vec3 centroid;
+        const float area = glm::length(triangle_area_normal(t, centroid));
+        mesh_centroid += centroid * area;
+        mesh_area += area;
+    }
+    mesh_centroid = mesh_area > 0.0f ? mesh_centroid / mesh_area : glm::vec3(0.0f);
+
+    for(TriangleCluster& cluster : clusters) {
+        glm::vec3 cluster_centroid(0.0f);
+        glm::vec3 cluster_normal(0.0f);
+        float cluster_area = 0.0f;
+        for(size_t t = cluster.begin; t != cluster.end; ++t) {
+            glm::vec3 centroid;
+            const glm::vec3 area_normal = triangle_area_normal(t, centroid);
+            const float area = glm::length(area_normal);
+            cluster_centroid += centroid * area;
+            cluster_normal += area_normal;
+            cluster_area += area;
+        }
+
+        if(cluster_area > 0.0f) {
+            cluster_centroid /= cluster_area;
+        }
+        const float normal_length = glm::length(cluster_normal);
+        if(normal_length > 0.0f) {
+            cluster_normal /= normal_length;
+        }
+        cluster.sort_key = glm::dot(cluster_centroid - mesh_centroid, cluster_normal);
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster& a, const TriangleCluster& b) { return a.sort_key > b.sort_key; });
+
+    std::vector<u32> result;
+    result.reserve(triangle_count * 3);
+    for(const TriangleCluster& cluster : clusters) {
+        result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+    std::copy(result.begin(), result.end(), indices.data());
+}
+
+void optimize_vertex_fetch(MeshData& mesh) {
+    const u32 unused = u32(-1);
+    std::vector<u32> remap(mesh.vertices.size(), unused);
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for(u32& index : mesh.indices) {
+        if(remap[index] == unused) {
+            remap[index] = u32(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    mesh.vertices = std::move(vertices);
+}
+
+void optimize_mesh(MeshData& mesh) {
+    optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+    optimize_overdraw(mesh.indices, mesh.vertices);
+    optimize_vertex_fetch(mesh);
+}
+
+}
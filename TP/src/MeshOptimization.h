@@ -0,0 +1,33 @@
+#ifndef MESHOPTIMIZATION_H
+#define MESHOPTIMIZATION_H
+
+#include <StaticMesh.h>
+
+namespace OM3D {
+
+struct VertexCacheStats {
+    // Average cache miss ratio: vertex shader invocations per triangle (0.5 at best, 3 at worst)
+    float acmr = 0.0f;
+    // Average transformed vertex ratio: vertex shader invocations per vertex (1 at best)
+    float atvr = 0.0f;
+};
+
+// Simulates a FIFO post-transform vertex cache
+VertexCacheStats analyze_vertex_cache(Span<const u32> indices, size_t vertex_count, u32 cache_size = 16);
+
+// Reorders triangles to maximize post-transform cache hits (Forsyth's linear-speed algorithm)
+void optimize_vertex_cache(Span<u32> indices, size_t vertex_count);
+
+// Reorders clusters of cache-optimized triangles so that outward facing ones are drawn first (Tipsify style).
+// Clusters are only split where the cache efficiency loss stays under `threshold`
+void optimize_overdraw(Span<u32> indices, Span<const Vertex> vertices, float threshold = 1.05f);
+
+// Reorders vertices by first use, and remaps indices accordingly
+void optimize_vertex_fetch(MeshData& mesh);
+
+// Runs all the above in order
+void optimize_mesh(MeshData& mesh);
+
+}
+
+#endif // MESHOPTIMIZATION_H
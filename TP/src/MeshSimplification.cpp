@@ -0,0 +1,357 @@
+#include "MeshSimplification.h"
+
+#include <MeshOptimization.h>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+namespace OM3D {
+
+// Sum of weighted squared distances to planes: p^T A p + 2 b.p + c, with A symmetric
+struct Quadric {
+    double a00 = 0.0, a11 = 0.0, a22 = 0.0;
+    double a01 = 0.0, a02 = 0.0, a12 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    Quadric& operator+=(const Quadric& other) {
+        a00 += other.a00; a11 += other.a11; a22 += other.a22;
+        a01 += other.a01; a02 += other.a02; a12 += other.a12;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+};
+
+// Plane dot(normal, p) + d = 0, normal must be normalized
+static Quadric plane_quadric(const glm::vec3& normal, float d, float weight) {
+    const double x = normal.x;
+    const double y = normal.y;
+    const double z = normal.z;
+    const double w = weight;
+
+    Quadric q;
+    q.a00 = x * x * w; q.a11 = y * y * w; q.a22 = z * z * w;
+    q.a01 = x * y * w; q.a02 = x * z * w; q.a12 = y * z * w;
+    q.b0 = x * d * w; q.b1 = y * d * w; q.b2 = z * d * w;
+    q.c = double(d) * d * w;
+    q.weight = w;
+    return q;
+}
+
+// Weighted average distance to the quadric's planes
+static float quadric_error(const Quadric& q, const glm::vec3& p) {
+    const double x = p.x;
+    const double y = p.y;
+    const double z = p.z;
+
+    const double e =
+        q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+        2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+        2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+        q.c;
+
+    return q.weight > 0.0 ? float(std::sqrt(std::abs(e) / q.weight)) : 0.0f;
+}
+
+// Vertices sharing a position get the index of one of them
+static std::vector<u32> weld_positions(Span<const Vertex> vertices) {
+    std::vector<u32> order(vertices.size());
+    std::iota(order.begin(), order.end(), 0u);
+
+    auto less = [&](u32 a, u32 b) {
+        const glm::vec3& pa = vertices[a].position;
+        const glm::vec3& pb = vertices[b].position;
+        return std::tie(pa.x, pa.y, pa.z) < std::tie(pb.x, pb.y, pb.z);
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<u32> welded(vertices.size());
+    for(size_t i = 0; i != order.size(); ++i) {
+        const bool same = i && vertices[order[i]].position == vertices[order[i - 1]].position;
+        welded[order[i]] = same ? welded[order[i - 1]] : order[i];
+    }
+    return welded;
+}
+
+enum class VertexKind : u8 {
+    Manifold,
+    // On exactly one open boundary loop
+    Border,
+    // Attribute seams and non-manifold vertices
+    Locked,
+};
+
+struct EdgeCollapse {
+    u32 from;
+    u32 to;
+    float error;
+};
+
+std::vector<u32> simplify_mesh(Span<const Vertex> vertices, Span<const u32> indices, size_t target_index_count, float target_error, float& result_error) {
+    std::vector<u32> result(indices.begin(), indices.end());
+    result_error = 0.0f;
+    if(result.size() <= target_index_count) {
+        return result;
+    }
+
+    const size_t vertex_count = vertices.size();
+    const std::vector<u32> welded = weld_positions(vertices);
+
+    // Topology is tracked on welded vertices, with directed edges
+    auto edge_key = [&](u32 a, u32 b) {
+        return (u64(welded[a]) << 32) | welded[b];
+    };
+
+    std::unordered_map<u64, u32> edges;
+    auto is_border = [&](u32 a, u32 b) {
+        return edges.count(edge_key(a, b)) && !edges.count(edge_key(b, a));
+    };
+
+    std::vector<VertexKind> kind(vertex_count, VertexKind::Manifold);
+    {
+        for(size_t i = 0; i != result.size(); ++i) {
+            ++edges[edge_key(result[i], result[i - i % 3 + (i + 1) % 3])];
+        }
+
+        std::vector<u32> border_edges(vertex_count, 0);
+        for(const auto& [key, count] : edges) {
+            const u32 a = u32(key >> 32);
+            const u32 b = u32(key);
+            const auto opposite = edges.find((u64(b) << 32) | a);
+            if(count > 1 || (opposite != edges.end() && opposite->second > 1)) {
+                kind[a] = kind[b] = VertexKind::Locked;
+            } else if(opposite == edges.end()) {
+                ++border_edges[a];
+                ++border_edges[b];
+            }
+        }
+
+        std::vector<u32> wedges(vertex_count, 0);
+        std::vector<bool> referenced(vertex_count, false);
+        for(const u32 index : result) {
+            if(!referenced[index]) {
+                referenced[index] = true;
+                ++wedges[welded[index]];
+            }
+        }
+
+        for(size_t v = 0; v != vertex_count; ++v) {
+            if(wedges[v] > 1 || (border_edges[v] && border_edges[v] != 2)) {
+                kind[v] = VertexKind::Locked;
+            } else if(border_edges[v] && kind[v] != VertexKind::Locked) {
+                kind[v] = VertexKind::Border;
+            }
+        }
+    }
+
+    // Borders get an extra plane orthogonal to their triangle, so that they don't shrink
+    const float border_weight = 10.0f;
+    std::vector<Quadric> quadrics(vertex_count);
+    for(size_t i = 0; i != result.size(); i += 3) {
+        const u32 tri[] = {result[i + 0], result[i + 1], result[i + 2]};
+        const glm::vec3& p0 = vertices[tri[0]].position;
+        glm::vec3 normal = glm::cross(vertices[tri[1]].position - p0, vertices[tri[2]].position - p0);
+        const float area = glm::length(normal);
+        if(area <= 0.0f) {
+            continue;
+        }
+        normal /= area;
+
+        const Quadric q = plane_quadric(normal, -glm::dot(normal, p0), area * 0.5f);
+        for(const u32 v : tri) {
+            quadrics[welded[v]] += q;
+        }
+
+        for(u32 k = 0; k != 3; ++k) {
+            const u32 a = tri[k];
+            const u32 b = tri[(k + 1) % 3];
+            if(!is_border(a, b)) {
+                continue;
+            }
+
+            const glm::vec3 edge = vertices[b].position - vertices[a].position;
+            const float length = glm::length(edge);
+            if(length <= 0.0f) {
+                continue;
+            }
+
+            const glm::vec3 edge_normal = glm::normalize(glm::cross(edge, normal));
+            const Quadric border = plane_quadric(edge_normal, -glm::dot(edge_normal, vertices[a].position), length * length * border_weight);
+            quadrics[welded[a]] += border;
+            quadrics[welded[b]] += border;
+        }
+    }
+
+    std::vector<u32> adjacency_offsets(vertex_count + 1);
+    std::vector<u32> adjacency;
+    std::vector<u32> remap(vertex_count);
+    std::vector<bool> locked(vertex_count);
+    std::vector<EdgeCollapse> collapses;
+
+    // Each pass collapses the cheapest edges, at most once per vertex neighbourhood, until enough triangles are removed
+    while(result.size() > target_index_count) {
+        edges.clear();
+        for(size_t i = 0; i != result.size(); ++i) {
+            ++edges[edge_key(result[i], result[i - i % 3 + (i + 1) % 3])];
+        }
+
+        std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0u);
+        for(const u32 index : result) {
+            ++adjacency_offsets[index + 1];
+        }
+        std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+        adjacency.resize(result.size());
+        {
+            std::vector<u32> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+            for(size_t i = 0; i != result.size(); ++i) {
+                adjacency[fill[result[i]]++] = u32(i / 3);
+            }
+        }
+
+        collapses.clear();
+        auto consider = [&](u32 from, u32 to) {
+            const VertexKind from_kind = kind[welded[from]];
+            if(from_kind == VertexKind::Locked) {
+                return;
+            }
+            if(from_kind == VertexKind::Border && !is_border(from, to) && !is_border(to, from)) {
+                return;
+            }
+
+            Quadric q = quadrics[welded[from]];
+            q += quadrics[welded[to]];
+            collapses.push_back({from, to, quadric_error(q, vertices[to].position)});
+        };
+        for(size_t i = 0; i != result.size(); ++i) {
+            const u32 a = result[i];
+            const u32 b = result[i - i % 3 + (i + 1) % 3];
+            consider(a, b);
+            consider(b, a);
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const EdgeCollapse& a, const EdgeCollapse& b) { return a.error < b.error; });
+
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(locked.begin(), locked.end(), false);
+
+        const size_t triangle_goal = (result.size() - target_index_count) / 3;
+        size_t removed_triangles = 0;
+        size_t applied = 0;
+
+        for(const EdgeCollapse& collapse : collapses) {
+            if(collapse.error > target_error || removed_triangles >= triangle_goal) {
+                break;
+            }
+            if(locked[collapse.from] || locked[collapse.to]) {
+                continue;
+            }
+
+            // Triangles around `from` must be untouched by this pass and must not flip
+            bool valid = true;
+            size_t removed = 0;
+            for(u32 j = adjacency_offsets[collapse.from]; valid && j != adjacency_offsets[collapse.from + 1]; ++j) {
+                const u32* tri = result.data() + adjacency[j] * 3;
+                if(remap[tri[0]] != tri[0] || remap[tri[1]] != tri[1] || remap[tri[2]] != tri[2]) {
+                    valid = false;
+                    break;
+                }
+                if(tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+                    ++removed;
+                    continue;
+                }
+
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for(u32 k = 0; k != 3; ++k) {
+                    before[k] = vertices[tri[k]].position;
+                    after[k] = vertices[tri[k] == collapse.from ? collapse.to : tri[k]].position;
+                }
+                const glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+                valid = glm::dot(normal_before, normal_after) > 0.0f;
+            }
+            if(!valid) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            for(u32 j = adjacency_offsets[collapse.from]; j != adjacency_offsets[collapse.from + 1]; ++j) {
+                const u32* tri = result.data() + adjacency[j] * 3;
+                locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = true;
+            }
+
+            quadrics[welded[collapse.to]] += quadrics[welded[collapse.from]];
+            result_error = std::max(result_error, collapse.error);
+            removed_triangles += removed;
+            ++applied;
+        }
+
+        if(!applied) {
+            break;
+        }
+
+        size_t write = 0;
+        for(size_t i = 0; i != result.size(); i += 3) {
+            const u32 a = remap[result[i + 0]];
+            const u32 b = remap[result[i + 1]];
+            const u32 c = remap[result[i + 2]];
+            if(a != b && b != c && a != c) {
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+        }
+        result.resize(write);
+    }
+
+    return result;
+}
+
+std::vector<MeshLod> build_lods(Span<const Vertex> vertices, std::vector<u32>& indices, u32 lod_count, float error, bool optimize) {
+    std::vector<MeshLod> lods = {{0, u32(indices.size()), 0.0f}};
+    if(vertices.is_empty() || indices.empty()) {
+        return lods;
+    }
+
+    glm::vec3 min = vertices[0].position;
+    glm::vec3 max = vertices[0].position;
+    for(const Vertex& v : vertices) {
+        min = glm::min(min, v.position);
+        max = glm::max(max, v.position);
+    }
+    float target_error = error * glm::length(max - min) * 0.5f;
+
+    const size_t full_index_count = indices.size();
+    size_t previous_index_count = full_index_count;
+    for(u32 i = 1; i <= lod_count; ++i, target_error *= 2.0f) {
+        const size_t target_index_count = (full_index_count / 3 >> i) * 3;
+
+        float lod_error = 0.0f;
+        std::vector<u32> lod = simplify_mesh(vertices, Span<const u32>(indices.data(), full_index_count), target_index_count, target_error, lod_error);
+
+        // Not worth switching to
+        if(lod.empty() || lod.size() > previous_index_count * 85 / 100) {
+            break;
+        }
+
+        if(optimize) {
+            optimize_vertex_cache(lod, vertices.size());
+        }
+
+        lods.push_back({u32(indices.size()), u32(lod.size()), std::max(lod_error, lods.back().error)});
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        previous_index_count = lod.size();
+    }
+
+    return lods;
+}
+
+}
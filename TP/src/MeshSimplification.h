@@ -0,0 +1,30 @@
+#ifndef MESHSIMPLIFICATION_H
+#define MESHSIMPLIFICATION_H
+
+#include <Vertex.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// Range of a mesh's index buffer drawing one level of detail
+struct MeshLod {
+    u32 first_index;
+    u32 index_count;
+    // Largest distance (in object space) between the simplified and full resolution surfaces, 0 for the full mesh
+    float error;
+};
+
+// Quadric error edge collapse, only moving vertices onto existing ones so that the vertex buffer can be shared.
+// Attribute seams are kept as is and borders only collapse along themselves.
+// Stops at `target_index_count` or once a collapse would go over `target_error`, returns the error reached
+std::vector<u32> simplify_mesh(Span<const Vertex> vertices, Span<const u32> indices, size_t target_index_count, float target_error, float& result_error);
+
+// Appends up to `lod_count` simplified copies of the indices, each halving the triangle count of the previous one.
+// The error allowed for the first LOD is `error` (relative to the mesh radius), doubled for every following one.
+// LODs that don't remove enough triangles are dropped. Returns the full mesh followed by the LODs
+std::vector<MeshLod> build_lods(Span<const Vertex> vertices, std::vector<u32>& indices, u32 lod_count, float error, bool optimize);
+
+}
+
+#endif // MESHSIMPLIFICATION_H
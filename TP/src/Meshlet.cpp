@@ -0,0 +1,107 @@
+#include "Meshlet.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace OM3D {
+
+static Meshlet compute_meshlet_bounds(Span<const Vertex> vertices, Span<const u32> indices, u32 first_index, u32 index_count) {
+    Meshlet meshlet = {};
+    meshlet.first_index = first_index;
+    meshlet.index_count = index_count;
+
+    glm::vec3 min = vertices[indices[first_index]].position;
+    glm::vec3 max = min;
+    for(u32 i = first_index; i != first_index + index_count; ++i) {
+        min = glm::min(min, vertices[indices[i]].position);
+        max = glm::max(max, vertices[indices[i]].position);
+    }
+
+    meshlet.center = (min + max) * 0.5f;
+    meshlet.radius = 0.0f;
+    for(u32 i = first_index; i != first_index + index_count; ++i) {
+        meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].position - meshlet.center));
+    }
+
+    // Counter clockwise triangles are front facing
+    std::vector<glm::vec3> normals;
+    glm::vec3 axis(0.0f);
+    for(u32 i = first_index; i != first_index + index_count; i += 3) {
+        const glm::vec3& a = vertices[indices[i + 0]].position;
+        const glm::vec3& b = vertices[indices[i + 1]].position;
+        const glm::vec3& c = vertices[indices[i + 2]].position;
+        const glm::vec3 n = glm::cross(b - a, c - a);
+        const float len = glm::length(n);
+        if(len > 0.0f) {
+            normals.push_back(n / len);
+            axis += n / len;
+        }
+    }
+
+    // Never culled
+    meshlet.cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.cone_cutoff = 1.0f;
+
+    const float axis_length = glm::length(axis);
+    if(axis_length <= 0.0f) {
+        return meshlet;
+    }
+    axis /= axis_length;
+
+    float min_dot = 1.0f;
+    for(const glm::vec3& n : normals) {
+        min_dot = std::min(min_dot, glm::dot(n, axis));
+    }
+
+    // Cones wider than a half sphere can always be seen from somewhere
+    if(min_dot > 0.0f) {
+        meshlet.cone_axis = axis;
+        meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+    return meshlet;
+}
+
+std::vector<Meshlet> build_meshlets(Span<const Vertex> vertices, Span<const u32> indices) {
+    std::vector<Meshlet> meshlets;
+
+    // Vertices used by the meshlet being built, tracked by the meshlet index that last used them
+    std::vector<u32> vertex_meshlet(vertices.size(), u32(-1));
+    u32 vertex_count = 0;
+    u32 first_index = 0;
+
+    const u32 index_count = u32(indices.size() / 3 * 3);
+    for(u32 i = 0; i != index_count; i += 3) {
+        const u32 current = u32(meshlets.size());
+
+        u32 new_vertices = 0;
+        for(u32 k = 0; k != 3; ++k) {
+            new_vertices += vertex_meshlet[indices[i + k]] != current && std::find(indices.begin() + i, indices.begin() + i + k, indices[i + k]) == indices.begin() + i + k;
+        }
+
+        const bool full = vertex_count + new_vertices > meshlet_max_vertices || (i - first_index) / 3 == meshlet_max_triangles;
+        if(full) {
+            meshlets.push_back(compute_meshlet_bounds(vertices, indices, first_index, i - first_index));
+            first_index = i;
+            vertex_count = 0;
+        }
+
+        for(u32 k = 0; k != 3; ++k) {
+            u32& last = vertex_meshlet[indices[i + k]];
+            if(last != u32(meshlets.size())) {
+                last = u32(meshlets.size());
+                ++vertex_count;
+            }
+        }
+    }
+
+    if(first_index != index_count) {
+        meshlets.push_back(compute_meshlet_bounds(vertices, indices, first_index, index_count - first_index));
+    }
+
+    return meshlets;
+}
+
+}
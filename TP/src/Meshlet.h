@@ -0,0 +1,32 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <Vertex.h>
+
+#include <vector>
+
+namespace OM3D {
+
+static constexpr u32 meshlet_max_vertices = 64;
+static constexpr u32 meshlet_max_triangles = 124;
+
+// Contiguous range of a mesh's index buffer, with its object space bounds
+struct Meshlet {
+    glm::vec3 center;
+    float radius;
+
+    // Average triangle normal. The meshlet faces away from any viewer for which
+    // dot(center - viewer, cone_axis) >= cone_cutoff * length(center - viewer) + radius
+    glm::vec3 cone_axis;
+    float cone_cutoff;
+
+    u32 first_index;
+    u32 index_count;
+};
+
+// Splits the triangles into meshlets in index order, so the index buffer is meant to be optimized beforehand
+std::vector<Meshlet> build_meshlets(Span<const Vertex> vertices, Span<const u32> indices);
+
+}
+
+#endif // MESHLET_H
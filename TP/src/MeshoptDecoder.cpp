@@ -0,0 +1,756 @@
+#include "MeshoptDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OM3D_MESHOPT_SSE
+#include <emmintrin.h>
+#endif
+
+namespace OM3D {
+
+// Bitstream formats from meshoptimizer, as referenced by the EXT_meshopt_compression specification
+static constexpr u8 vertex_header = 0xA0;
+static constexpr u8 index_header = 0xE0;
+static constexpr u8 sequence_header = 0xD0;
+
+static constexpr size_t byte_group_size = 16;
+static constexpr size_t byte_group_decode_limit = 24;
+static constexpr size_t vertex_block_size_bytes = 8192;
+static constexpr size_t vertex_block_max_size = 256;
+static constexpr size_t tail_max_size = 32;
+
+
+
+// ------------------------------------ Vertex codec ------------------------------------
+
+static size_t vertex_block_size(size_t vertex_size) {
+    const size_t size = (vertex_block_size_bytes / vertex_size) & ~(byte_group_size - 1);
+    return size < vertex_block_max_size ? size : vertex_block_max_size;
+}
+
+// With 2 and 4 bits per byte, the all ones value means that the byte is stored after the group
+template<u32 bits>
+static const u8* decode_packed_group(const u8* data, u8* out) {
+    constexpr u32 sentinel = (1 << bits) - 1;
+    const u8* extra = data + byte_group_size * bits / 8;
+    for(size_t i = 0; i != byte_group_size; ++i) {
+        const u32 value = (data[i * bits / 8] >> (8 - bits - (i * bits) % 8)) & sentinel;
+        const bool is_extra = value == sentinel;
+        out[i] = is_extra ? *extra : u8(value);
+        extra += is_extra;
+    }
+    return extra;
+}
+
+// Groups of 16 bytes are stored with 0, 2, 4 or 8 bits per byte
+static const u8* decode_bytes_group(const u8* data, u8* out, u32 bits_log2) {
+    switch(bits_log2) {
+        case 0:
+            std::memset(out, 0, byte_group_size);
+            return data;
+
+        case 1:
+            return decode_packed_group<2>(data, out);
+
+        case 2:
+            return decode_packed_group<4>(data, out);
+
+        default:
+            std::memcpy(out, data, byte_group_size);
+            return data + byte_group_size;
+    }
+}
+
+static const u8* decode_bytes(const u8* data, const u8* data_end, u8* out, size_t size) {
+    DEBUG_ASSERT(size % byte_group_size == 0);
+
+    // 2 bits of header per group
+    const u8* header = data;
+    const size_t header_size = (size / byte_group_size + 3) / 4;
+    if(size_t(data_end - data) < header_size) {
+        return nullptr;
+    }
+    data += header_size;
+
+    for(size_t i = 0; i != size; i += byte_group_size) {
+        // The stream always ends with the tail, which makes reading the largest group safe
+        if(size_t(data_end - data) < byte_group_decode_limit) {
+            return nullptr;
+        }
+
+        const size_t group = i / byte_group_size;
+        const u32 bits_log2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+        data = decode_bytes_group(data, out + i, bits_log2);
+    }
+
+    return data;
+}
+
+#ifdef OM3D_MESHOPT_SSE
+static __m128i unzigzag8(__m128i v) {
+    const __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, _mm_set1_epi8(1)));
+    const __m128i magnitude = _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(127));
+    return _mm_xor_si128(sign, magnitude);
+}
+#else
+static u8 unzigzag8(u8 v) {
+    return u8(-(v & 1) ^ (v >> 1));
+}
+#endif
+
+// Every byte of the vertex is stored as its own stream of zigzag encoded deltas from the previous vertex
+static const u8* decode_vertex_block(const u8* data, const u8* data_end, u8* vertex_data, size_t vertex_count, size_t vertex_size, u8* last_vertex) {
+    DEBUG_ASSERT(vertex_count > 0 && vertex_count <= vertex_block_max_size);
+
+    const size_t aligned_count = (vertex_count + byte_group_size - 1) & ~(byte_group_size - 1);
+
+#ifdef OM3D_MESHOPT_SSE
+    // Four byte streams at once: they are transposed so that each 32 bit lane holds one vertex,
+    // and the deltas are summed across lanes with a log step prefix sum
+    alignas(16) u8 streams[vertex_block_max_size * 4];
+    for(size_t k = 0; k != vertex_size; k += 4) {
+        for(size_t s = 0; s != 4; ++s) {
+            data = decode_bytes(data, data_end, streams + s * aligned_count, aligned_count);
+            if(!data) {
+                return nullptr;
+            }
+        }
+
+        i32 last = 0;
+        std::memcpy(&last, last_vertex + k, sizeof(last));
+        __m128i prev = _mm_set1_epi32(last);
+
+        for(size_t i = 0; i < vertex_count; i += 16) {
+            const __m128i r0 = _mm_load_si128(reinterpret_cast<const __m128i*>(streams + 0 * aligned_count + i));
+            const __m128i r1 = _mm_load_si128(reinterpret_cast<const __m128i*>(streams + 1 * aligned_count + i));
+            const __m128i r2 = _mm_load_si128(reinterpret_cast<const __m128i*>(streams + 2 * aligned_count + i));
+            const __m128i r3 = _mm_load_si128(reinterpret_cast<const __m128i*>(streams + 3 * aligned_count + i));
+
+            const __m128i x0 = _mm_unpacklo_epi8(r0, r1);
+            const __m128i x1 = _mm_unpackhi_epi8(r0, r1);
+            const __m128i x2 = _mm_unpacklo_epi8(r2, r3);
+            const __m128i x3 = _mm_unpackhi_epi8(r2, r3);
+
+            const __m128i vertices[] = {
+                _mm_unpacklo_epi16(x0, x2),
+                _mm_unpackhi_epi16(x0, x2),
+                _mm_unpacklo_epi16(x1, x3),
+                _mm_unpackhi_epi16(x1, x3),
+            };
+
+            for(size_t v = 0; v != 4; ++v) {
+                __m128i t = unzigzag8(vertices[v]);
+                t = _mm_add_epi8(t, _mm_slli_si128(t, 4));
+                t = _mm_add_epi8(t, _mm_slli_si128(t, 8));
+                t = _mm_add_epi8(t, prev);
+                prev = _mm_shuffle_epi32(t, _MM_SHUFFLE(3, 3, 3, 3));
+
+                for(size_t l = 0; l != 4; ++l) {
+                    const size_t index = i + v * 4 + l;
+                    if(index < vertex_count) {
+                        const i32 value = _mm_cvtsi128_si32(t);
+                        std::memcpy(vertex_data + index * vertex_size + k, &value, sizeof(value));
+                    }
+                    t = _mm_srli_si128(t, 4);
+                }
+            }
+        }
+
+        last = _mm_cvtsi128_si32(prev);
+        std::memcpy(last_vertex + k, &last, sizeof(last));
+    }
+#else
+    u8 stream[vertex_block_max_size];
+    for(size_t k = 0; k != vertex_size; ++k) {
+        data = decode_bytes(data, data_end, stream, aligned_count);
+        if(!data) {
+            return nullptr;
+        }
+
+        u8 prev = last_vertex[k];
+        for(size_t i = 0; i != vertex_count; ++i) {
+            prev = u8(unzigzag8(stream[i]) + prev);
+            vertex_data[i * vertex_size + k] = prev;
+        }
+        last_vertex[k] = prev;
+    }
+#endif
+
+    return data;
+}
+
+static bool decode_vertex_buffer(u8* out, size_t vertex_count, size_t vertex_size, const u8* data, size_t size) {
+    if(vertex_size == 0 || vertex_size > 256 || vertex_size % 4 != 0) {
+        return false;
+    }
+
+    const size_t tail_size = vertex_size < tail_max_size ? tail_max_size : vertex_size;
+    if(size < 1 + tail_size || (data[0] & 0xF0) != vertex_header || (data[0] & 0x0F) != 0) {
+        return false;
+    }
+
+    const u8* data_end = data + size;
+    ++data;
+
+    // The tail stores the first vertex, which the first deltas are relative to
+    u8 last_vertex[256];
+    std::memcpy(last_vertex, data_end - vertex_size, vertex_size);
+
+    const size_t block_size = vertex_block_size(vertex_size);
+    for(size_t first = 0; first < vertex_count; first += block_size) {
+        const size_t count = std::min(block_size, vertex_count - first);
+        data = decode_vertex_block(data, data_end, out + first * vertex_size, count, vertex_size, last_vertex);
+        if(!data) {
+            return false;
+        }
+    }
+
+    return size_t(data_end - data) == tail_size;
+}
+
+
+
+// ------------------------------------ Index codecs ------------------------------------
+
+static u32 decode_vbyte(const u8*& data) {
+    const u8 lead = *data++;
+    if(lead < 128) {
+        return lead;
+    }
+
+    u32 result = lead & 127;
+    for(u32 shift = 7; shift != 35; shift += 7) {
+        const u8 group = *data++;
+        result |= u32(group & 127) << shift;
+        if(group < 128) {
+            break;
+        }
+    }
+    return result;
+}
+
+static u32 decode_index(const u8*& data, u32 last) {
+    const u32 v = decode_vbyte(data);
+    return last + ((v >> 1) ^ u32(-i32(v & 1)));
+}
+
+static void write_index(u8* out, size_t i, size_t index_size, u32 index) {
+    if(index_size == 2) {
+        const u16 value = u16(index);
+        std::memcpy(out + i * 2, &value, sizeof(value));
+    } else {
+        std::memcpy(out + i * 4, &index, sizeof(index));
+    }
+}
+
+// Triangles reference recent edges and vertices through two 16 entry FIFOs, other indices are delta encoded
+struct TriangleDecoder {
+    u32 edges[16][2];
+    u32 vertices[16];
+    u32 edge_offset = 0;
+    u32 vertex_offset = 0;
+
+    TriangleDecoder() {
+        std::memset(edges, 0xFF, sizeof(edges));
+        std::memset(vertices, 0xFF, sizeof(vertices));
+    }
+
+    void push_edge(u32 a, u32 b) {
+        edges[edge_offset][0] = a;
+        edges[edge_offset][1] = b;
+        edge_offset = (edge_offset + 1) & 15;
+    }
+
+    void push_vertex(u32 v, bool cond = true) {
+        vertices[vertex_offset] = v;
+        vertex_offset = (vertex_offset + cond) & 15;
+    }
+
+    u32 vertex(u32 age) const {
+        return vertices[(vertex_offset - age) & 15];
+    }
+};
+
+static bool decode_triangle_buffer(u8* out, size_t index_count, size_t index_size, const u8* data, size_t size) {
+    // At least the header, one code per triangle and the 16 byte auxiliary code table
+    if(index_count % 3 != 0 || size < 1 + index_count / 3 + 16 || (data[0] & 0xF0) != index_header) {
+        return false;
+    }
+
+    const u32 version = data[0] & 0x0F;
+    if(version > 1) {
+        return false;
+    }
+
+    // Version 1 encodes +-1 index deltas in the codes
+    const u32 max_cached = version >= 1 ? 13 : 15;
+
+    TriangleDecoder fifo;
+    u32 next = 0;
+    u32 last = 0;
+
+    const u8* code = data + 1;
+    const u8* extra = code + index_count / 3;
+    const u8* extra_end = data + size - 16;
+    const u8* aux_table = extra_end;
+
+    for(size_t i = 0; i != index_count; i += 3) {
+        // A triangle reads at most 16 bytes of extra data, which the table guarantees to be there
+        if(extra > extra_end) {
+            return false;
+        }
+
+        const u8 codetri = *code++;
+        if(codetri < 0xF0) {
+            // Triangle sharing a recent edge
+            const u32 edge = (fifo.edge_offset - 1 - (codetri >> 4)) & 15;
+            const u32 a = fifo.edges[edge][0];
+            const u32 b = fifo.edges[edge][1];
+
+            const u32 fec = codetri & 15;
+            u32 c = 0;
+            if(fec < max_cached) {
+                c = fec == 0 ? next++ : fifo.vertex(1 + fec);
+                fifo.push_vertex(c, fec == 0);
+            } else {
+                last = c = fec != 15 ? last + (fec == 13 ? u32(-1) : 1u) : decode_index(extra, last);
+                fifo.push_vertex(c);
+            }
+
+            write_index(out, i + 0, index_size, a);
+            write_index(out, i + 1, index_size, b);
+            write_index(out, i + 2, index_size, c);
+            fifo.push_edge(c, b);
+            fifo.push_edge(a, c);
+
+        } else {
+            // Triangle with no shared edge, its vertices are new, cached or explicit
+            // Explicit triangles read their codes from the extra data and can hold delta encoded indices
+            const bool is_explicit = codetri >= 0xFE;
+            u32 a = 0;
+            u32 feb = 0;
+            u32 fec = 0;
+            if(!is_explicit) {
+                const u8 codeaux = aux_table[codetri & 15];
+                feb = codeaux >> 4;
+                fec = codeaux & 15;
+                a = next++;
+            } else {
+                const u8 codeaux = *extra++;
+                feb = codeaux >> 4;
+                fec = codeaux & 15;
+                if(codeaux == 0) {
+                    next = 0;
+                }
+                a = codetri == 0xFE ? next++ : 0;
+            }
+
+            u32 b = feb == 0 ? next++ : fifo.vertex(feb);
+            u32 c = fec == 0 ? next++ : fifo.vertex(fec);
+
+            if(codetri == 0xFF) {
+                last = a = decode_index(extra, last);
+            }
+            if(is_explicit && feb == 15) {
+                last = b = decode_index(extra, last);
+            }
+            if(is_explicit && fec == 15) {
+                last = c = decode_index(extra, last);
+            }
+
+            write_index(out, i + 0, index_size, a);
+            write_index(out, i + 1, index_size, b);
+            write_index(out, i + 2, index_size, c);
+            fifo.push_vertex(a);
+            fifo.push_vertex(b, feb == 0 || (is_explicit && feb == 15));
+            fifo.push_vertex(c, fec == 0 || (is_explicit && fec == 15));
+            fifo.push_edge(b, a);
+            fifo.push_edge(c, b);
+            fifo.push_edge(a, c);
+        }
+    }
+
+    return extra == extra_end;
+}
+
+static bool decode_index_sequence(u8* out, size_t index_count, size_t index_size, const u8* data, size_t size) {
+    // At least the header, one byte per index and a 4 byte tail
+    if(size < 1 + index_count + 4 || (data[0] & 0xF0) != sequence_header || (data[0] & 0x0F) > 1) {
+        return false;
+    }
+
+    const u8* end = data + size - 4;
+    ++data;
+
+    // Indices are deltas from one of two baselines, chosen by the low bit
+    u32 last[2] = {};
+    for(size_t i = 0; i != index_count; ++i) {
+        if(data >= end) {
+            return false;
+        }
+
+        u32 v = decode_vbyte(data);
+        const u32 baseline = v & 1;
+        v >>= 1;
+
+        last[baseline] += (v >> 1) ^ u32(-i32(v & 1));
+        write_index(out, i, index_size, last[baseline]);
+    }
+
+    return data == end;
+}
+
+
+
+// ------------------------------------ Filters ------------------------------------
+
+static i32 round_to_int(float x) {
+    return i32(x + (x >= 0.0f ? 0.5f : -0.5f));
+}
+
+#ifdef OM3D_MESHOPT_SSE
+static __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Same rounding as round_to_int
+static __m128i round_to_int(__m128 x) {
+    const __m128 positive = _mm_cmpge_ps(x, _mm_setzero_ps());
+    return _mm_cvttps_epi32(_mm_add_ps(x, select(positive, _mm_set1_ps(0.5f), _mm_set1_ps(-0.5f))));
+}
+#endif
+
+// Directions stored as octahedral x and y, with z holding the encoding scale. The fourth component is kept as is
+template<typename T>
+static void decode_octahedral(T* data, size_t count) {
+    const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+
+    size_t i = 0;
+#ifdef OM3D_MESHOPT_SSE
+    for(; i + 4 <= count; i += 4) {
+        alignas(16) float in[3][4];
+        for(size_t l = 0; l != 4; ++l) {
+            for(size_t c = 0; c != 3; ++c) {
+                in[c][l] = float(data[(i + l) * 4 + c]);
+            }
+        }
+
+        __m128 x = _mm_load_ps(in[0]);
+        __m128 y = _mm_load_ps(in[1]);
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+        const __m128 z = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(in[2]), _mm_andnot_ps(sign_mask, x)), _mm_andnot_ps(sign_mask, y));
+
+        const __m128 t = _mm_min_ps(z, _mm_setzero_ps());
+        const __m128 neg_t = _mm_xor_ps(t, sign_mask);
+        x = _mm_add_ps(x, select(_mm_cmpge_ps(x, _mm_setzero_ps()), t, neg_t));
+        y = _mm_add_ps(y, select(_mm_cmpge_ps(y, _mm_setzero_ps()), t, neg_t));
+
+        const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        const __m128 scale = _mm_div_ps(_mm_set1_ps(max), len);
+
+        alignas(16) i32 out[3][4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(out[0]), round_to_int(_mm_mul_ps(x, scale)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(out[1]), round_to_int(_mm_mul_ps(y, scale)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(out[2]), round_to_int(_mm_mul_ps(z, scale)));
+        for(size_t l = 0; l != 4; ++l) {
+            for(size_t c = 0; c != 3; ++c) {
+                data[(i + l) * 4 + c] = T(out[c][l]);
+            }
+        }
+    }
+#endif
+
+    for(; i != count; ++i) {
+        float x = float(data[i * 4 + 0]);
+        float y = float(data[i * 4 + 1]);
+        const float z = float(data[i * 4 + 2]) - std::abs(x) - std::abs(y);
+
+        // Unfold the lower hemisphere
+        const float t = z < 0.0f ? z : 0.0f;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        const float scale = max / std::sqrt(x * x + y * y + z * z);
+        data[i * 4 + 0] = T(round_to_int(x * scale));
+        data[i * 4 + 1] = T(round_to_int(y * scale));
+        data[i * 4 + 2] = T(round_to_int(z * scale));
+    }
+}
+
+// Unit quaternions stored as their three smallest components, the last one holds the index of the largest component
+// in its two low bits and the encoding scale in the others
+static void decode_quaternion(i16* data, size_t count) {
+    const float scale = 1.0f / std::sqrt(2.0f);
+
+    auto store = [](i16* q, i32 x, i32 y, i32 z, i32 w) {
+        const u32 largest = u32(q[3]) & 3;
+        q[(largest + 1) & 3] = i16(x);
+        q[(largest + 2) & 3] = i16(y);
+        q[(largest + 3) & 3] = i16(z);
+        q[(largest + 0) & 3] = i16(w);
+    };
+
+    size_t i = 0;
+#ifdef OM3D_MESHOPT_SSE
+    for(; i + 4 <= count; i += 4) {
+        alignas(16) float in[4][4];
+        for(size_t l = 0; l != 4; ++l) {
+            const i16* q = data + (i + l) * 4;
+            in[0][l] = float(q[0]);
+            in[1][l] = float(q[1]);
+            in[2][l] = float(q[2]);
+            in[3][l] = scale / float(q[3] | 3);
+        }
+
+        const __m128 s = _mm_load_ps(in[3]);
+        const __m128 x = _mm_mul_ps(_mm_load_ps(in[0]), s);
+        const __m128 y = _mm_mul_ps(_mm_load_ps(in[1]), s);
+        const __m128 z = _mm_mul_ps(_mm_load_ps(in[2]), s);
+
+        const __m128 ww = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        const __m128 w = _mm_sqrt_ps(_mm_max_ps(ww, _mm_setzero_ps()));
+
+        const __m128 max = _mm_set1_ps(32767.0f);
+        alignas(16) i32 out[4][4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(out[0]), round_to_int(_mm_mul_ps(x, max)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(out[1]), round_to_int(_mm_mul_ps(y, max)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(out[2]), round_to_int(_mm_mul_ps(z, max)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(out[3]), round_to_int(_mm_mul_ps(w, max)));
+        for(size_t l = 0; l != 4; ++l) {
+            store(data + (i + l) * 4, out[0][l], out[1][l], out[2][l], out[3][l]);
+        }
+    }
+#endif
+
+    for(; i != count; ++i) {
+        i16* q = data + i * 4;
+        const float s = scale / float(q[3] | 3);
+        const float x = float(q[0]) * s;
+        const float y = float(q[1]) * s;
+        const float z = float(q[2]) * s;
+
+        // Clamped to avoid NaNs from precision errors
+        const float ww = 1.0f - x * x - y * y - z * z;
+        const float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+
+        store(q, round_to_int(x * 32767.0f), round_to_int(y * 32767.0f), round_to_int(z * 32767.0f), round_to_int(w * 32767.0f));
+    }
+}
+
+// Floats stored as a 24 bit signed mantissa and an 8 bit signed exponent
+static void decode_exponential(u8* data, size_t count) {
+    size_t i = 0;
+#ifdef OM3D_MESHOPT_SSE
+    for(; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 4));
+        const __m128i mantissa = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        const __m128i exponent = _mm_srai_epi32(v, 24);
+        const __m128 pow2 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23));
+        _mm_storeu_ps(reinterpret_cast<float*>(data + i * 4), _mm_mul_ps(pow2, _mm_cvtepi32_ps(mantissa)));
+    }
+#endif
+
+    for(; i != count; ++i) {
+        u32 v = 0;
+        std::memcpy(&v, data + i * 4, sizeof(v));
+
+        const i32 mantissa = i32(v << 8) >> 8;
+        const i32 exponent = i32(v) >> 24;
+
+        const u32 pow2_bits = u32(exponent + 127) << 23;
+        float pow2 = 0.0f;
+        std::memcpy(&pow2, &pow2_bits, sizeof(pow2));
+
+        const float value = pow2 * float(mantissa);
+        std::memcpy(data + i * 4, &value, sizeof(value));
+    }
+}
+
+
+
+Result<void> decode_meshopt_buffer(Span<const u8> encoded, MeshoptMode mode, MeshoptFilter filter, size_t count, size_t stride, Span<u8> out) {
+    if(out.size() != count * stride || encoded.is_empty()) {
+        return {false};
+    }
+
+    bool ok = false;
+    switch(mode) {
+        case MeshoptMode::Attributes:
+            ok = decode_vertex_buffer(out.data(), count, stride, encoded.data(), encoded.size());
+        break;
+
+        case MeshoptMode::Triangles:
+            ok = (stride == 2 || stride == 4) && decode_triangle_buffer(out.data(), count, stride, encoded.data(), encoded.size());
+        break;
+
+        case MeshoptMode::Indices:
+            ok = (stride == 2 || stride == 4) && decode_index_sequence(out.data(), count, stride, encoded.data(), encoded.size());
+        break;
+    }
+
+    if(!ok) {
+        return {false};
+    }
+
+    // Filters only apply to attributes
+    if(filter != MeshoptFilter::None && mode != MeshoptMode::Attributes) {
+        return {false};
+    }
+
+    switch(filter) {
+        case MeshoptFilter::None:
+        break;
+
+        case MeshoptFilter::Octahedral:
+            if(stride == 4) {
+                decode_octahedral(reinterpret_cast<i8*>(out.data()), count);
+            } else if(stride == 8) {
+                decode_octahedral(reinterpret_cast<i16*>(out.data()), count);
+            } else {
+                return {false};
+            }
+        break;
+
+        case MeshoptFilter::Quaternion:
+            if(stride != 8) {
+                return {false};
+            }
+            decode_quaternion(reinterpret_cast<i16*>(out.data()), count);
+        break;
+
+        case MeshoptFilter::Exponential:
+            decode_exponential(out.data(), count * stride / 4);
+        break;
+    }
+
+    return {true};
+}
+
+
+
+// ------------------------------------ Benchmark ------------------------------------
+
+static u8 zigzag8(u8 delta) {
+    return u8((delta << 1) ^ u8(i8(delta) >> 7));
+}
+
+// Picks the smallest of the 0, 2, 4 or 8 bits per byte group encodings
+static void encode_bytes(std::vector<u8>& encoded, const u8* bytes, size_t size) {
+    DEBUG_ASSERT(size % byte_group_size == 0);
+
+    const size_t header = encoded.size();
+    encoded.resize(encoded.size() + (size / byte_group_size + 3) / 4, 0);
+
+    for(size_t i = 0; i != size; i += byte_group_size) {
+        const u8* group = bytes + i;
+        size_t extra_2 = 0;
+        size_t extra_4 = 0;
+        bool zero = true;
+        for(size_t k = 0; k != byte_group_size; ++k) {
+            extra_2 += group[k] >= 3;
+            extra_4 += group[k] >= 15;
+            zero &= group[k] == 0;
+        }
+
+        const size_t sizes[] = {zero ? 0 : byte_group_size + 1, 4 + extra_2, 8 + extra_4, byte_group_size};
+        const u32 bits_log2 = u32(std::min_element(std::begin(sizes), std::end(sizes)) - std::begin(sizes));
+        encoded[header + i / byte_group_size / 4] |= u8(bits_log2 << ((i / byte_group_size % 4) * 2));
+
+        if(bits_log2 == 3) {
+            encoded.insert(encoded.end(), group, group + byte_group_size);
+        } else if(bits_log2 != 0) {
+            const u32 bits = 1 << bits_log2;
+            const u32 sentinel = (1 << bits) - 1;
+            const size_t packed = encoded.size();
+            encoded.resize(encoded.size() + byte_group_size * bits / 8, 0);
+            for(size_t k = 0; k != byte_group_size; ++k) {
+                const u32 value = std::min(u32(group[k]), sentinel);
+                encoded[packed + k * bits / 8] |= u8(value << (8 - bits - (k * bits) % 8));
+                if(value == sentinel) {
+                    encoded.push_back(group[k]);
+                }
+            }
+        }
+    }
+}
+
+static std::vector<u8> encode_vertex_buffer(Span<const u8> vertices, size_t vertex_size) {
+    const size_t vertex_count = vertices.size() / vertex_size;
+    std::vector<u8> encoded = {vertex_header};
+
+    u8 last_vertex[256] = {};
+    std::memcpy(last_vertex, vertices.data(), vertex_size);
+
+    const size_t block_size = vertex_block_size(vertex_size);
+    for(size_t first = 0; first < vertex_count; first += block_size) {
+        const size_t count = std::min(block_size, vertex_count - first);
+        const size_t aligned_count = (count + byte_group_size - 1) & ~(byte_group_size - 1);
+
+        u8 stream[vertex_block_max_size] = {};
+        for(size_t k = 0; k != vertex_size; ++k) {
+            for(size_t i = 0; i != count; ++i) {
+                const u8 value = vertices[(first + i) * vertex_size + k];
+                stream[i] = zigzag8(u8(value - last_vertex[k]));
+                last_vertex[k] = value;
+            }
+            encode_bytes(encoded, stream, aligned_count);
+        }
+    }
+
+    const size_t tail_size = vertex_size < tail_max_size ? tail_max_size : vertex_size;
+    encoded.resize(encoded.size() + tail_size - vertex_size, 0);
+    encoded.insert(encoded.end(), vertices.begin(), vertices.begin() + vertex_size);
+    return encoded;
+}
+
+bool meshopt_benchmark() {
+    // A 1024x1024 grid of quantized vertices: 16 bit position and uv, 8 bit octahedral normal
+    constexpr size_t grid_size = 1024;
+    constexpr size_t vertex_size = 16;
+    std::vector<u8> vertices(grid_size * grid_size * vertex_size);
+    u32 seed = 42;
+    for(size_t i = 0; i != grid_size * grid_size; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        const u16 x = u16(i % grid_size * 64);
+        const u16 y = u16((seed >> 16) & 0x3FF);
+        const u16 z = u16(i / grid_size * 64);
+        const u16 position[] = {x, y, z, 0};
+        const i8 normal[] = {i8((seed >> 8) & 0x1F), 127, i8((seed >> 20) & 0x1F), 0};
+        const u16 uv[] = {u16(x * 2), u16(z * 2)};
+
+        u8* vertex = vertices.data() + i * vertex_size;
+        std::memcpy(vertex, position, sizeof(position));
+        std::memcpy(vertex + 8, normal, sizeof(normal));
+        std::memcpy(vertex + 12, uv, sizeof(uv));
+    }
+
+    const std::vector<u8> encoded = encode_vertex_buffer(vertices, vertex_size);
+    std::vector<u8> decoded(vertices.size());
+
+    // Averaged over a few runs, the first one faults the output pages in
+    constexpr u32 runs = 8;
+    double time = 0.0;
+    bool ok = true;
+    for(u32 i = 0; i != runs + 1; ++i) {
+        const double start = program_time();
+        ok &= decode_meshopt_buffer(encoded, MeshoptMode::Attributes, MeshoptFilter::None, grid_size * grid_size, vertex_size, decoded).is_ok;
+        time += i ? program_time() - start : 0.0;
+    }
+    ok &= decoded == vertices;
+    time /= runs;
+
+    std::cout << "EXT_meshopt_compression: " << std::round(vertices.size() / 1024.0 / 1024.0 * 100.0) / 100.0 << "MB ("
+              << std::round(encoded.size() / 1024.0 / 1024.0 * 100.0) / 100.0 << "MB encoded) decoded in "
+              << std::round(time * 1000.0 * 100.0) / 100.0 << "ms ("
+              << std::round(vertices.size() / std::max(time, 1e-9) / 1e9 * 100.0) / 100.0 << " GB/s)" << std::endl;
+    std::cout << (ok ? "Meshopt benchmark passed" : "Meshopt benchmark FAILED: decoded data doesn't match") << std::endl;
+    return ok;
+}
+
+}
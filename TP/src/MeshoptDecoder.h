@@ -0,0 +1,33 @@
+#ifndef MESHOPTDECODER_H
+#define MESHOPTDECODER_H
+
+#include <utils.h>
+
+namespace OM3D {
+
+// Buffer view modes and filters of EXT_meshopt_compression
+enum class MeshoptMode {
+    Attributes,
+    Triangles,
+    Indices,
+};
+
+enum class MeshoptFilter {
+    None,
+    Octahedral,
+    Quaternion,
+    Exponential,
+};
+
+// Decodes `count` elements of `stride` bytes from a meshopt compressed buffer view, then applies the filter in place.
+// `out` must be count * stride bytes. Fails on corrupted data or on strides that the mode doesn't allow.
+// Thread safe: meant to be run on several buffer views in parallel.
+Result<void> decode_meshopt_buffer(Span<const u8> encoded, MeshoptMode mode, MeshoptFilter filter, size_t count, size_t stride, Span<u8> out);
+
+// Encodes a fixed vertex buffer, checks that it decodes back to the same bytes and prints the decoding throughput.
+// Doesn't need a GPU or a scene, run with --meshopt-benchmark
+bool meshopt_benchmark();
+
+}
+
+#endif // MESHOPTDECODER_H
@@ -0,0 +1,246 @@
+#include "MipGeneration.h"
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OM3D_MIP_SSE
+#include <emmintrin.h>
+#endif
+
+namespace OM3D {
+
+// Linear RGBA value, one SSE register when available
+struct MipPixel {
+#ifdef OM3D_MIP_SSE
+    __m128 v;
+
+    static MipPixel zero() { return {_mm_setzero_ps()}; }
+    static MipPixel load(const float* src) { return {_mm_loadu_ps(src)}; }
+    void store(float* dst) const { _mm_storeu_ps(dst, v); }
+
+    MipPixel operator+(MipPixel other) const { return {_mm_add_ps(v, other.v)}; }
+    MipPixel operator*(float s) const { return {_mm_mul_ps(v, _mm_set1_ps(s))}; }
+#else
+    std::array<float, 4> v;
+
+    static MipPixel zero() { return {}; }
+    static MipPixel load(const float* src) { return {{src[0], src[1], src[2], src[3]}}; }
+    void store(float* dst) const { std::copy(v.begin(), v.end(), dst); }
+
+    MipPixel operator+(MipPixel other) const { return {{v[0] + other.v[0], v[1] + other.v[1], v[2] + other.v[2], v[3] + other.v[3]}}; }
+    MipPixel operator*(float s) const { return {{v[0] * s, v[1] * s, v[2] * s, v[3] * s}}; }
+#endif
+};
+
+struct MipTap {
+    int offset;
+    float weight;
+};
+
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for(int k = 1; k != 32; ++k) {
+        term *= (x * x) / (4.0 * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// Taps are relative to 2 * x, the first of the two source texels covered by destination texel x
+static std::vector<MipTap> build_kernel(MipFilter filter) {
+    if(filter == MipFilter::Box) {
+        return {{0, 0.5f}, {1, 0.5f}};
+    }
+
+    // Kaiser windowed sinc, 3 source texels on each side of the destination texel center
+    const double pi = glm::pi<double>();
+    const double alpha = 4.0;
+    const double radius = 1.5;
+
+    std::vector<MipTap> taps;
+    double total = 0.0;
+    for(int offset = -2; offset != 4; ++offset) {
+        // Distance between texel centers, in destination texels
+        const double x = (double(offset) - 0.5) * 0.5;
+        const double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+        const double r = x / radius;
+        const double window = bessel_i0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(alpha);
+        taps.push_back({offset, float(sinc * window)});
+        total += sinc * window;
+    }
+
+    for(MipTap& tap : taps) {
+        tap.weight = float(tap.weight / total);
+    }
+    return taps;
+}
+
+static const std::array<float, 256>& sRGB_to_linear_table() {
+    static const std::array<float, 256> table = [] {
+        std::array<float, 256> t = {};
+        for(u32 i = 0; i != 256; ++i) {
+            const float c = float(i) / 255.0f;
+            t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return t;
+    }();
+    return table;
+}
+
+static constexpr u32 linear_to_sRGB_steps = 16384;
+
+static const std::vector<u8>& linear_to_sRGB_table() {
+    static const std::vector<u8> table = [] {
+        std::vector<u8> t(linear_to_sRGB_steps);
+        for(u32 i = 0; i != linear_to_sRGB_steps; ++i) {
+            const float l = float(i) / float(linear_to_sRGB_steps - 1);
+            const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            t[i] = u8(std::round(std::clamp(c, 0.0f, 1.0f) * 255.0f));
+        }
+        return t;
+    }();
+    return table;
+}
+
+static u8 encode_unorm(float value) {
+    return u8(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static u8 encode_sRGB(float value) {
+    return linear_to_sRGB_table()[u32(std::clamp(value, 0.0f, 1.0f) * float(linear_to_sRGB_steps - 1) + 0.5f)];
+}
+
+static std::vector<float> decode_level(const TextureData& texture, bool sRGB) {
+    const size_t pixels = size_t(texture.size.x) * size_t(texture.size.y);
+    const size_t channels = texture.format == ImageFormat::RGB8_UNORM || texture.format == ImageFormat::RGB8_sRGB ? 3 : 4;
+    const auto& to_linear = sRGB_to_linear_table();
+
+    std::vector<float> result(pixels * 4);
+    for(size_t i = 0; i != pixels; ++i) {
+        const u8* src = texture.data.get() + i * channels;
+        for(size_t c = 0; c != 3; ++c) {
+            result[i * 4 + c] = sRGB ? to_linear[src[c]] : float(src[c]) / 255.0f;
+        }
+        result[i * 4 + 3] = channels == 4 ? float(src[3]) / 255.0f : 1.0f;
+    }
+    return result;
+}
+
+// Separable downsampling with clamp to edge addressing
+static std::vector<float> downsample(const std::vector<float>& src, const glm::uvec2& size, Span<const MipTap> kernel) {
+    const glm::uvec2 half = mip_size(size, 1);
+
+    auto clamp_coord = [](int coord, u32 extent) {
+        return size_t(std::clamp(coord, 0, int(extent) - 1));
+    };
+
+    // Horizontal pass: half.x by size.y
+    std::vector<float> rows(size_t(half.x) * size.y * 4);
+    for(u32 y = 0; y != size.y; ++y) {
+        const float* src_row = src.data() + size_t(y) * size.x * 4;
+        float* dst_row = rows.data() + size_t(y) * half.x * 4;
+        for(u32 x = 0; x != half.x; ++x) {
+            MipPixel sum = MipPixel::zero();
+            for(const MipTap& tap : kernel) {
+                sum = sum + MipPixel::load(src_row + clamp_coord(int(x * 2) + tap.offset, size.x) * 4) * tap.weight;
+            }
+            sum.store(dst_row + size_t(x) * 4);
+        }
+    }
+
+    // Vertical pass: half.x by half.y
+    std::vector<float> result(size_t(half.x) * half.y * 4);
+    for(u32 y = 0; y != half.y; ++y) {
+        float* dst_row = result.data() + size_t(y) * half.x * 4;
+        for(u32 x = 0; x != half.x; ++x) {
+            MipPixel sum = MipPixel::zero();
+            for(const MipTap& tap : kernel) {
+                sum = sum + MipPixel::load(rows.data() + (clamp_coord(int(y * 2) + tap.offset, size.y) * half.x + x) * 4) * tap.weight;
+            }
+            sum.store(dst_row + size_t(x) * 4);
+        }
+    }
+
+    return result;
+}
+
+static void renormalize(std::vector<float>& level) {
+    for(size_t i = 0; i < level.size(); i += 4) {
+        const glm::vec3 n = glm::vec3(level[i + 0], level[i + 1], level[i + 2]) * 2.0f - 1.0f;
+        const float len = glm::length(n);
+        if(len > 0.0f) {
+            const glm::vec3 encoded = n / len * 0.5f + 0.5f;
+            level[i + 0] = encoded.x;
+            level[i + 1] = encoded.y;
+            level[i + 2] = encoded.z;
+        }
+    }
+}
+
+Result<TextureData> generate_mips(const TextureData& texture, MipFilter filter, bool is_normal_map) {
+    if(texture.mip_levels != 1) {
+        return {false, {}};
+    }
+
+    bool sRGB = false;
+    switch(texture.format) {
+        case ImageFormat::RGBA8_sRGB:
+        case ImageFormat::RGB8_sRGB:
+            sRGB = true;
+        break;
+
+        case ImageFormat::RGBA8_UNORM:
+        case ImageFormat::RGB8_UNORM:
+        break;
+
+        default:
+            return {false, {}};
+    }
+
+    TextureData result;
+    result.size = texture.size;
+    result.format = sRGB ? ImageFormat::RGBA8_sRGB : ImageFormat::RGBA8_UNORM;
+    result.mip_levels = Texture::mip_levels(texture.size);
+    result.data = std::make_unique<u8[]>(image_byte_size(result.format, result.size, result.mip_levels));
+
+    const std::vector<MipTap> kernel = build_kernel(filter);
+    std::vector<float> level = decode_level(texture, sRGB);
+
+    u8* out = result.data.get();
+    glm::uvec2 level_size = result.size;
+    for(u32 i = 0; i != result.mip_levels; ++i) {
+        if(i) {
+            level = downsample(level, level_size, kernel);
+            level_size = mip_size(level_size, 1);
+            if(is_normal_map) {
+                renormalize(level);
+            }
+        }
+
+        const size_t level_bytes = image_byte_size(result.format, level_size);
+        if(!i && texture.format == result.format) {
+            // The top level is kept as is
+            std::copy_n(texture.data.get(), level_bytes, out);
+        } else {
+            for(size_t j = 0; j != level_bytes; j += 4) {
+                for(size_t c = 0; c != 3; ++c) {
+                    out[j + c] = sRGB ? encode_sRGB(level[j + c]) : encode_unorm(level[j + c]);
+                }
+                out[j + 3] = encode_unorm(level[j + 3]);
+            }
+        }
+        out += level_bytes;
+    }
+
+    return {true, std::move(result)};
+}
+
+}
@@ -0,0 +1,21 @@
+#ifndef MIPGENERATION_H
+#define MIPGENERATION_H
+
+#include <Texture.h>
+
+namespace OM3D {
+
+enum class MipFilter {
+    Box,
+    Kaiser,
+};
+
+// Builds the full mip chain of an 8 bit RGB(A) texture on the CPU.
+// Filtering is done in linear space (sRGB formats are converted first) and normal maps are renormalized at every level.
+// The result is RGBA8 in the same color space, with every level packed as expected by Texture.
+// Thread safe: meant to be run on several textures in parallel.
+Result<TextureData> generate_mips(const TextureData& texture, MipFilter filter, bool is_normal_map = false);
+
+}
+
+#endif // MIPGENERATION_H
@@ -1,109 +1,439 @@
 #include "Scene.h"
 
+#include <AsyncSceneLoader.h>
+#include <JobSystem.h>
 #include <TypedBuffer.h>
 
 #include <shader_structs.h>
 #include <utils.h>
 
+#include <glm/matrix.hpp>
+
 #include <algorithm>
+#include <numeric>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace OM3D {
 
 Scene::Scene() {
 }
 
+std::unique_ptr<Scene> Scene::from_data(const SceneData& data, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
+    return SceneUploader(data, pipeline, defines).finish();
+}
+
 void Scene::add_object(SceneObject obj) {
     _objects.emplace_back(std::move(obj));
+    _bvh_dirty = true;
+}
+
+void Scene::set_object_transform(size_t index, const glm::mat4& transform) {
+    _objects[index].set_transform(transform);
+    _bvh_refit = true;
+}
+
+void Scene::update_bounds() const {
+    if(!_bvh_dirty && !_bvh_refit) {
+        return;
+    }
+
+    std::vector<CenteredBox> boxes(_objects.size());
+    _object_spheres.resize(_objects.size());
+    for(size_t i = 0; i != _objects.size(); ++i) {
+        const BoundingSphere sphere = _objects[i].world_sphere();
+        _object_spheres.set(i, sphere.center, sphere.radius);
+        boxes[i] = _objects[i].world_box();
+    }
+
+    _gpu_scene = nullptr;
+    if(_bvh_dirty) {
+        _bvh.build(boxes);
+    } else {
+        _bvh.refit(boxes);
+    }
+    _bvh_dirty = false;
+    _bvh_refit = false;
 }
 
 void Scene::add_object(PointLight obj) {
+    _light_spheres.push_back(obj.position(), obj.radius());
     _point_lights.emplace_back(std::move(obj));
 }
 
-std::shared_ptr<TypedBuffer<shader::FrameData>> Scene::get_framedata_buffer(const glm::uvec2& window_size, const Camera& camera) const {
-    const auto buffer = std::make_shared<TypedBuffer<shader::FrameData>>(nullptr, 1);
-    {
-        auto mapping = buffer->map(AccessType::WriteOnly);
-        mapping[0].window_size = window_size;
-        mapping[0].camera.view_proj = camera.view_proj_matrix();
-        mapping[0].point_light_count = u32(_point_lights.size());
-        mapping[0].sun_color = glm::vec3(1.0f, 1.0f, 1.0f);
-        mapping[0].sun_dir = glm::normalize(_sun_direction);
+void Scene::set_required_defines(Span<const std::string> defines) {
+    _required_defines.assign(defines.begin(), defines.end());
+}
+
+void Scene::set_pipeline(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
+    std::vector<std::string> all_defines = _required_defines;
+    all_defines.insert(all_defines.end(), defines.begin(), defines.end());
+
+    // Materials are shared between objects: only the first use of each is rebound
+    std::unordered_set<const Material*> rebound;
+    for(const SceneObject& obj : _objects) {
+        const auto material = obj.get_material();
+        if(material && rebound.insert(material.get()).second) {
+            material->set_pipeline(pipeline, all_defines);
+        }
+    }
+}
+
+std::vector<std::shared_ptr<Program>> Scene::compile_pipeline(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) const {
+    std::vector<std::string> all_defines = _required_defines;
+    all_defines.insert(all_defines.end(), defines.begin(), defines.end());
+
+    std::vector<std::shared_ptr<Program>> programs;
+    std::unordered_set<const Material*> compiled;
+    for(const SceneObject& obj : _objects) {
+        const auto material = obj.get_material();
+        if(material && compiled.insert(material.get()).second) {
+            programs.push_back(material->pipeline_program(pipeline, all_defines));
+        }
     }
+
+    // Materials of the same kind share their program
+    std::sort(programs.begin(), programs.end());
+    programs.erase(std::unique(programs.begin(), programs.end()), programs.end());
+    return programs;
+}
+
+TransientBuffer<shader::FrameData> Scene::get_framedata_buffer(const glm::uvec2& window_size, const Camera& camera, size_t point_light_count) const {
+    const auto buffer = FrameAllocator::current().allocate<shader::FrameData>(1, BufferUsage::Uniform);
+    buffer[0].window_size = window_size;
+    buffer[0].camera.view_proj = camera.view_proj_matrix();
+    buffer[0].camera.inv_view_proj = glm::inverse(camera.view_proj_matrix());
+    buffer[0].camera.position = camera.position();
+    buffer[0].camera.forward = camera.forward();
+    buffer[0].point_light_count = u32(point_light_count);
+    buffer[0].sun_color = glm::vec3(1.0f, 1.0f, 1.0f);
+    buffer[0].sun_dir = glm::normalize(_sun_direction);
     return buffer;
 }
 
 std::vector<const PointLight*> Scene::get_in_frustum_lights(const Camera& camera) const {
     const auto frustum = camera.build_frustum();
 
+    std::vector<u32> visible;
+    cull_spheres(frustum, camera.position(), _light_spheres, visible);
+
     auto lights = std::vector<const PointLight*>();
-    for (const auto &light : _point_lights) {
-        if (camera.in_frustum(frustum, light.position(), light.radius()))
-            lights.push_back(&light);
+    lights.reserve(visible.size());
+    for (const u32 i : visible) {
+        lights.push_back(&_point_lights[i]);
     }
 
     return lights;
 }
 
-std::shared_ptr<TypedBuffer<shader::PointLight>> Scene::get_lights_buffer(std::vector<const PointLight*> lights) const {
-    const auto light_buffer = std::make_shared<TypedBuffer<shader::PointLight>>(nullptr, std::max(lights.size(), size_t(1)));
-    {
-        auto mapping = light_buffer->map(AccessType::WriteOnly);
-        for(size_t i = 0; i != lights.size(); ++i) {
-            const auto& light = lights[i];
-            mapping[i] = {
-                light->position(),
-                light->radius(),
-                light->color(),
-                0.0f
-            };
-        }
+TransientBuffer<shader::PointLight> Scene::get_lights_buffer(std::vector<const PointLight*> lights) const {
+    const auto light_buffer = FrameAllocator::current().allocate<shader::PointLight>(lights.size(), BufferUsage::Storage);
+    for(size_t i = 0; i != lights.size(); ++i) {
+        const auto& light = lights[i];
+        light_buffer[i] = {
+            light->position(),
+            light->radius(),
+            light->color(),
+            0.0f
+        };
     }
     return light_buffer;
 }
 
-RenderInfo Scene::render(const Camera& camera) const {
+// Appends a command for each run of visible meshlets of one instance, returns the number of triangles culled
+static size_t cull_meshlets(const StaticMesh& mesh, const glm::mat4& transform, bool cull_back_faces, u32 instance, const Frustum& frustum, const Camera& camera, std::vector<DrawElementsIndirectCommand>& commands) {
+    const glm::vec3 scale(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+    const float max_scale = std::max(std::max(scale.x, scale.y), scale.z);
+    const float min_scale = std::min(std::min(scale.x, scale.y), scale.z);
+
+    // Normal cones are only preserved by rotations and uniform scales, and mirroring flips the winding
+    const bool cone_culling = cull_back_faces && max_scale <= min_scale * 1.01f && glm::determinant(glm::mat3(transform)) > 0.0f;
+    const glm::vec3 camera_position = camera.position();
+
+    size_t culled_triangles = 0;
+    for(const Meshlet& meshlet : mesh.meshlets()) {
+        const glm::vec3 center = glm::vec3(transform * glm::vec4(meshlet.center, 1.0f));
+        const float radius = meshlet.radius * max_scale;
+
+        bool visible = camera.in_frustum(frustum, center, radius);
+        if(visible && cone_culling) {
+            const glm::vec3 axis = glm::mat3(transform) * meshlet.cone_axis / max_scale;
+            const glm::vec3 view = center - camera_position;
+            visible = glm::dot(view, axis) < meshlet.cone_cutoff * glm::length(view) + radius;
+        }
+
+        if(!visible) {
+            culled_triangles += meshlet.index_count / 3;
+            continue;
+        }
+
+        DrawElementsIndirectCommand* last = commands.empty() ? nullptr : &commands.back();
+        if(last && last->base_instance == instance && last->first_index + last->count == meshlet.first_index) {
+            last->count += meshlet.index_count;
+        } else {
+            commands.push_back({meshlet.index_count, 1, meshlet.first_index, 0, instance});
+        }
+    }
+
+    return culled_triangles;
+}
+
+// Starts from the previous LOD and only moves past thresholds widened by the hysteresis
+static u32 select_lod(Span<const MeshLod> lods, u32 previous, float pixels_per_unit, const RenderSettings& settings) {
+    const float refine_threshold = settings.lod_pixel_error * (1.0f + settings.lod_hysteresis);
+    const float coarsen_threshold = settings.lod_pixel_error * (1.0f - settings.lod_hysteresis);
+
+    u32 lod = std::min(previous, u32(lods.size() - 1));
+    while(lod > 0 && lods[lod].error * pixels_per_unit > refine_threshold) {
+        --lod;
+    }
+    while(lod + 1 < lods.size() && lods[lod + 1].error * pixels_per_unit <= coarsen_threshold) {
+        ++lod;
+    }
+    return lod;
+}
+
+// Screen pixels covered by one object space unit at the object's closest point
+static float pixels_per_unit(const SceneObject& obj, const Camera& camera, const RenderSettings& settings) {
+    const glm::mat4& transform = obj.transform();
+    const float scale = max_scale(transform);
+
+    const BoundingSphere sphere = obj.world_sphere();
+    const float distance = glm::length(sphere.center - camera.position()) - sphere.radius;
+    const float pixels_per_world_unit = camera.projection_matrix()[1][1] * settings.viewport_height * 0.5f / std::max(distance, 1e-3f);
+    return scale * pixels_per_world_unit;
+}
+
+// Objects per job in the loops of render: the culling ones are a few hundred nanoseconds per object
+static constexpr size_t object_grain = 1024;
+// Meshlet culling is per meshlet, so it's worth splitting for far fewer objects
+static constexpr size_t meshlet_object_grain = 16;
+
+// Occluders are the objects that cover the most of the screen, up to this many and OcclusionBuffer::triangle_budget
+static constexpr size_t max_occluders = 256;
+
+size_t Scene::cull_occluded(const Camera& camera, std::vector<u32>& visible, RenderInfo& info) const {
+    // Radius over distance stands for the screen size
+    std::vector<std::pair<float, u32>> candidates;
+    candidates.reserve(visible.size());
+    for (const u32 i : visible) {
+        const auto& material = _objects[i].get_material();
+        if (!material || !can_occlude(*material)) {
+            continue;
+        }
+        const glm::vec3 center(_object_spheres.x[i], _object_spheres.y[i], _object_spheres.z[i]);
+        candidates.push_back({_object_spheres.radius[i] / std::max(glm::length(center - camera.position()), 1e-3f), i});
+    }
+    if (candidates.size() > max_occluders) {
+        std::nth_element(candidates.begin(), candidates.begin() + max_occluders, candidates.end(), std::greater<>());
+        candidates.resize(max_occluders);
+    }
+    std::sort(candidates.begin(), candidates.end(), std::greater<>());
+
+    _occlusion_buffer.begin(camera.view_proj_matrix());
+    size_t triangles = 0;
+    for (const auto& [size, i] : candidates) {
+        const SceneObject& obj = _objects[i];
+        const OccluderMesh& occluder = obj.get_mesh()->occluder();
+        if (occluder.indices.empty() || triangles + occluder.triangle_count() > OcclusionBuffer::triangle_budget) {
+            continue;
+        }
+        triangles += occluder.triangle_count();
+        _occlusion_buffer.add_occluder(occluder, obj.transform(), !obj.get_material()->culls_back_faces());
+    }
+    _occlusion_buffer.rasterize();
+    info.occluder_triangles = _occlusion_buffer.triangle_count();
+
+    // Merged in order, like the frustum culling
+    std::vector<std::vector<u32>> chunk_visible(chunk_count(visible.size(), object_grain));
+    parallel_for_chunks(visible.size(), object_grain, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t k = begin; k != end; ++k) {
+            if (!_occlusion_buffer.is_occluded(_objects[visible[k]].world_box())) {
+                chunk_visible[chunk].push_back(visible[k]);
+            }
+        }
+    });
+
+    const size_t tested = visible.size();
+    visible.clear();
+    for (const std::vector<u32>& chunk : chunk_visible) {
+        visible.insert(visible.end(), chunk.begin(), chunk.end());
+    }
+    return tested - visible.size();
+}
+
+struct RenderBatch {
+    std::shared_ptr<Material> material;
+    u32 lod = 0;
+    std::vector<const SceneObject*> objects;
+};
+
+RenderInfo Scene::render(const Camera& camera, const RenderSettings& settings) const {
 
     const auto frustum = camera.build_frustum();
 
-    auto map = std::unordered_map<size_t, std::pair<std::shared_ptr<Material>, std::vector<const SceneObject*>>>();
+    RenderInfo info;
+    info.scene_objects = _objects.size();
 
-    for (const auto &obj : _objects) {
-        size_t key = std::hash<Material *>()(obj.get_material().get());
-        hash_combine(key, obj.get_mesh()->hash);
-        if (obj.in_frustum(frustum, camera)) {
-            map[key].first = obj.get_material();
-            map[key].second.push_back(&obj);
+    _object_lods.resize(_objects.size(), 0);
+
+    update_bounds();
+
+    if (settings.gpu_driven) {
+        if (!_gpu_scene) {
+            _gpu_scene = std::make_unique<GPUScene>(_objects);
         }
+        const GPUSceneStats stats = _gpu_scene->render(camera, settings.lod_selection ? settings.lod_pixel_error : 0.0f, settings.viewport_height, settings.occlusion_culling ? settings.depth : nullptr);
+        info.draw_instanced_calls = stats.multi_draws;
+        info.objects_occluded = stats.objects_occluded;
+        info.objects_culled = _objects.size() - std::min(_objects.size(), stats.objects_visible + stats.objects_occluded);
+        return info;
+    }
+
+    // Objects of subtrees entirely in the frustum are visible, the others have to be tested
+    std::vector<u32> visible;
+    std::vector<u32> candidates;
+    if (settings.bvh_culling) {
+        const BVHCullStats stats = _bvh.cull(frustum, camera.position(), visible, candidates);
+        info.bvh_nodes_visited = stats.nodes_visited;
     }
 
+    // Chunks test their spheres in batches, then the tighter boxes of the objects that passed. Merged in order
+    const size_t test_count = settings.bvh_culling ? candidates.size() : _objects.size();
+    std::vector<std::vector<u32>> chunk_visible(chunk_count(test_count, object_grain));
+    parallel_for_chunks(test_count, object_grain, [&](size_t chunk, size_t begin, size_t end) {
+        std::vector<u32> in_spheres;
+        if (settings.bvh_culling) {
+            BoundingSpheres spheres;
+            spheres.resize(end - begin);
+            for (size_t i = begin; i != end; ++i) {
+                const u32 object = candidates[i];
+                spheres.set(i - begin, glm::vec3(_object_spheres.x[object], _object_spheres.y[object], _object_spheres.z[object]), _object_spheres.radius[object]);
+            }
+            cull_spheres(frustum, camera.position(), spheres, in_spheres);
+            for (u32& i : in_spheres) {
+                i = candidates[begin + i];
+            }
+        } else {
+            cull_spheres(frustum, camera.position(), _object_spheres, begin, end - begin, in_spheres);
+        }
+
+        for (const u32 i : in_spheres) {
+            const CenteredBox box = _objects[i].world_box();
+            if (camera.in_frustum(frustum, box.center, box.extents)) {
+                chunk_visible[chunk].push_back(i);
+            }
+        }
+    });
+
+    for (const std::vector<u32>& chunk : chunk_visible) {
+        visible.insert(visible.end(), chunk.begin(), chunk.end());
+    }
+    info.objects_tested = test_count;
+    info.objects_culled = _objects.size() - visible.size();
+
+    if (settings.software_occlusion) {
+        const double start = program_time();
+        info.objects_occluded = cull_occluded(camera, visible, info);
+        info.software_occlusion_ms = (program_time() - start) * 1000.0;
+    }
+
+    // LODs and batch keys only depend on each object
+    std::vector<size_t> keys(visible.size());
+    parallel_for_chunks(visible.size(), object_grain, [&](size_t, size_t begin, size_t end) {
+        for (size_t k = begin; k != end; ++k) {
+            const u32 i = visible[k];
+            const auto& obj = _objects[i];
+
+            const auto& mesh = obj.get_mesh();
+            const u32 lod = settings.lod_selection ? select_lod(mesh->lods(), _object_lods[i], pixels_per_unit(obj, camera, settings), settings) : 0;
+            _object_lods[i] = lod;
+
+            size_t key = std::hash<Material *>()(obj.get_material().get());
+            hash_combine(key, mesh->hash);
+            hash_combine(key, size_t(lod));
+            keys[k] = key;
+        }
+    });
+
+    auto map = std::unordered_map<size_t, RenderBatch>();
+
+    for (size_t k = 0; k != visible.size(); ++k) {
+        const auto& obj = _objects[visible[k]];
+        const u32 lod = _object_lods[visible[k]];
+
+        auto& batch = map[keys[k]];
+        batch.material = obj.get_material();
+        batch.lod = lod;
+        batch.objects.push_back(&obj);
+
+        info.lod_objects.resize(std::max(info.lod_objects.size(), size_t(lod) + 1), 0);
+        ++info.lod_objects[lod];
+    }
+
+    info.draw_instanced_calls = map.size();
+
+    // Instance indices for indirect draws, which read base_instance as an attribute rather than through
+    // ARB_shader_draw_parameters
+    if (settings.meshlet_culling) {
+        size_t max_instances = 1;
+        for (const auto& pair : map) {
+            max_instances = std::max(max_instances, pair.second.objects.size());
+        }
+        if (max_instances > _instance_indices.element_count()) {
+            std::vector<u32> indices(std::max(max_instances, _instance_indices.element_count() * 2));
+            std::iota(indices.begin(), indices.end(), 0u);
+            _instance_indices = TypedBuffer<u32>(indices.data(), indices.size());
+        }
+    }
+
+    std::vector<DrawElementsIndirectCommand> commands;
+
     // Render every object
     for (const auto& pair : map) {
-        const auto& material = pair.second.first;
-        const auto& objects = pair.second.second;
-
-        const auto transform_buffer = std::make_shared<TypedBuffer<shader::Model>>(nullptr, std::max(objects.size(), size_t(1)));
-        {
-            auto mapping = transform_buffer->map(AccessType::WriteOnly);
-            for(size_t i = 0; i != objects.size(); ++i) {
-                const auto& obj = objects[i];
-                mapping[i] = {
-                    obj->transform()
+        const auto& material = pair.second.material;
+        const auto& objects = pair.second.objects;
+        const u32 lod = pair.second.lod;
+
+        // Ranges are allocated on this thread, jobs only write to the mapped memory
+        const auto transform_buffer = FrameAllocator::current().allocate<shader::Model>(objects.size(), BufferUsage::Storage);
+        parallel_for_chunks(objects.size(), object_grain, [&](size_t, size_t begin, size_t end) {
+            for(size_t i = begin; i != end; ++i) {
+                transform_buffer[i] = {
+                    objects[i]->transform()
                 };
             }
-        }
-        transform_buffer->bind(BufferUsage::Storage, 2);
+        });
+        transform_buffer.bind(BufferUsage::Storage, 2);
 
         material->bind();
         auto mesh = objects[0]->get_mesh();
-        mesh->draw_instanced(objects.size());
+        if (settings.meshlet_culling && lod == 0 && !mesh->meshlets().is_empty()) {
+            std::vector<std::vector<DrawElementsIndirectCommand>> chunk_commands(chunk_count(objects.size(), meshlet_object_grain));
+            std::vector<size_t> chunk_culled(chunk_commands.size(), 0);
+            parallel_for_chunks(objects.size(), meshlet_object_grain, [&](size_t chunk, size_t begin, size_t end) {
+                for(size_t i = begin; i != end; ++i) {
+                    chunk_culled[chunk] += cull_meshlets(*mesh, objects[i]->transform(), material->culls_back_faces(), u32(i), frustum, camera, chunk_commands[chunk]);
+                }
+            });
+
+            // Commands never merge across chunks as they belong to different instances
+            commands.clear();
+            for(size_t chunk = 0; chunk != chunk_commands.size(); ++chunk) {
+                commands.insert(commands.end(), chunk_commands[chunk].begin(), chunk_commands[chunk].end());
+                info.triangles_culled += chunk_culled[chunk];
+            }
+            for(const DrawElementsIndirectCommand& command : commands) {
+                info.triangles_submitted += command.count / 3;
+            }
+            mesh->draw_indirect(commands, _instance_indices);
+        } else {
+            mesh->draw_instanced(objects.size(), lod);
+            info.triangles_submitted += mesh->triangle_count(lod) * objects.size();
+        }
     }
 
-    return RenderInfo{
-        _objects.size(),
-        map.size(),
-    };
+    return info;
 }
 
 }
@@ -2,8 +2,14 @@
 #define SCENE_H
 
 #include <SceneObject.h>
+#include <SceneData.h>
 #include <PointLight.h>
 #include <Camera.h>
+#include <BVH.h>
+#include <FrustumCulling.h>
+#include <FrameAllocator.h>
+#include <GPUScene.h>
+#include <SoftwareOcclusion.h>
 
 #include <shader_structs.h>
 
@@ -12,9 +18,52 @@
 
 namespace OM3D {
 
+class AsyncSceneLoader;
+
+struct RenderSettings {
+    // Culls and picks LODs in a compute shader that writes the draw commands, instead of on the CPU.
+    // Meshlet culling and LOD hysteresis are CPU only
+    bool gpu_driven = false;
+
+    // GPU-driven only: also culls objects hidden by the depth pyramid of the previous frame, needs `depth`
+    bool occlusion_culling = true;
+    // Depth attachment of the framebuffer being rendered to
+    const Texture* depth = nullptr;
+
+    // Walks the scene's BVH instead of testing every object against the frustum
+    bool bvh_culling = true;
+
+    // CPU path only: the largest objects on screen are rasterized on the CPU as occluders, objects behind them are culled
+    bool software_occlusion = false;
+
+    // Skips meshlets that are outside the frustum or back facing, for meshes imported with meshlets
+    bool meshlet_culling = true;
+
+    // Picks the coarsest LOD whose simplification error stays under `lod_pixel_error` pixels on screen.
+    // An object only switches once the error crosses the threshold by `lod_hysteresis` (relative), to avoid popping
+    bool lod_selection = true;
+    float lod_pixel_error = 1.0f;
+    float lod_hysteresis = 0.25f;
+    float viewport_height = 900.0f;
+};
+
 struct RenderInfo {
     size_t scene_objects = 0;
+    size_t objects_culled = 0;
+    // Objects in the frustum but hidden by others
+    size_t objects_occluded = 0;
+    size_t occluder_triangles = 0;
+    // Selecting and rasterizing the occluders, then testing the objects
+    double software_occlusion_ms = 0.0;
+    size_t bvh_nodes_visited = 0;
+    // Objects tested individually against the frustum, the others were accepted or rejected with their BVH subtree
+    size_t objects_tested = 0;
+    // Multi draws when GPU-driven, which only reports those and the culled objects (a few frames late)
     size_t draw_instanced_calls = 0;
+    size_t triangles_submitted = 0;
+    size_t triangles_culled = 0;
+    // Number of rendered objects using each LOD
+    std::vector<size_t> lod_objects;
 };
 
 class Scene : NonMovable {
@@ -22,27 +71,64 @@ class Scene : NonMovable {
     public:
         Scene();
 
-        static Result<std::unique_ptr<Scene>> from_gltf(const std::string& file_name, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines = {});
+        static Result<std::unique_ptr<Scene>> from_gltf(const std::string& file_name, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines = {}, const SceneImportSettings& settings = {});
+        static std::unique_ptr<AsyncSceneLoader> from_gltf_async(const std::string& file_name, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines = {}, const SceneImportSettings& settings = {});
+        static std::unique_ptr<Scene> from_data(const SceneData& data, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines = {});
 
-        std::shared_ptr<TypedBuffer<shader::FrameData>> get_framedata_buffer(const glm::uvec2& window_size, const Camera& camera) const;
+        // `point_light_count` is the number of lights in the buffer bound along with it
+        TransientBuffer<shader::FrameData> get_framedata_buffer(const glm::uvec2& window_size, const Camera& camera, size_t point_light_count) const;
 
         std::vector<const PointLight*> get_in_frustum_lights(const Camera& camera) const;
-        std::shared_ptr<TypedBuffer<shader::PointLight>> get_lights_buffer(std::vector<const PointLight*> lights) const;
+        TransientBuffer<shader::PointLight> get_lights_buffer(std::vector<const PointLight*> lights) const;
 
         size_t get_point_light_count() const { return _point_lights.size(); }
 
         const std::vector<SceneObject>& get_objects() { return _objects; }
         const std::vector<PointLight>& get_point_lights() { return _point_lights; }
 
-        RenderInfo render(const Camera& camera) const;
+        RenderInfo render(const Camera& camera, const RenderSettings& settings = {}) const;
+
+        // Defines the scene's data needs (e.g. for its vertex format), added to every pipeline the materials are bound to
+        void set_required_defines(Span<const std::string> defines);
+
+        // Rebinds every material to another pipeline and define set in place, meshes and textures are kept as is
+        void set_pipeline(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines = {});
+
+        // Compiles the programs set_pipeline would bind, they stay cached for as long as the result is kept alive
+        std::vector<std::shared_ptr<Program>> compile_pipeline(const std::pair<const char *, const char *> pipeline, Span<const std::string> defines = {}) const;
 
         void add_object(SceneObject obj);
+        // Moved objects are handled by refitting the BVH on the next render
+        void set_object_transform(size_t index, const glm::mat4& transform);
         void add_object(PointLight obj);
 
     private:
         std::vector<SceneObject> _objects;
         std::vector<PointLight> _point_lights;
         glm::vec3 _sun_direction = glm::vec3(0.2f, 1.0f, 0.1f);
+        std::vector<std::string> _required_defines;
+
+        // LOD of each object on the previous frame, for hysteresis
+        mutable std::vector<u32> _object_lods;
+
+        // Removes the objects hidden by the largest of them from `visible`, returns how many were
+        size_t cull_occluded(const Camera& camera, std::vector<u32>& visible, RenderInfo& info) const;
+        mutable OcclusionBuffer _occlusion_buffer;
+
+        // Objects' world space bounds, updated lazily by render
+        void update_bounds() const;
+        mutable BVH _bvh;
+        mutable BoundingSpheres _object_spheres;
+        mutable bool _bvh_dirty = true;
+        mutable bool _bvh_refit = false;
+
+        // 0, 1, 2... read by indirect draws as their instance index, only grown
+        mutable TypedBuffer<u32> _instance_indices;
+
+        // Built on the first GPU-driven render, dropped whenever the bounds change
+        mutable std::unique_ptr<GPUScene> _gpu_scene;
+
+        BoundingSpheres _light_spheres;
 };
 
 }
@@ -0,0 +1,324 @@
+#include "SceneData.h"
+
+#include <MappedFile.h>
+#include <Texture.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace OM3D {
+
+// Baked scene layout: a header, followed by the mesh, image, material, object and light tables,
+// followed by the vertex, index, meshlet, LOD and image blobs (aligned so they can be used straight from the mapping)
+namespace baked {
+
+static constexpr u32 magic = 0x44334D4F; // "OM3D"
+static constexpr u32 version = 9;
+static constexpr u64 blob_alignment = 16;
+
+// Byte range from the start of the file
+struct Blob {
+    u64 offset;
+    u64 size;
+};
+
+struct Header {
+    u32 magic;
+    u32 version;
+    u64 cache_key;
+    u64 file_size;
+
+    u32 mesh_count;
+    u32 image_count;
+    u32 material_count;
+    u32 object_count;
+    u32 light_count;
+    u32 padding;
+};
+
+struct Mesh {
+    Blob vertices;
+    Blob indices;
+    Blob meshlets;
+    Blob lods;
+    u64 hash;
+    MeshBounds bounds;
+    u32 vertex_format;
+    PositionDequantization dequantization;
+    u32 index_type;
+    QuantizedLayout quantized_layout;
+};
+
+struct Image {
+    Blob data;
+    glm::uvec2 size;
+    u32 format;
+    u32 mip_levels;
+};
+
+using Material = SceneData::Material;
+using Object = SceneData::Object;
+using Light = SceneData::Light;
+
+static u64 align_up(u64 offset) {
+    return (offset + blob_alignment - 1) / blob_alignment * blob_alignment;
+}
+
+}
+
+
+u64 SceneImportSettings::hash() const {
+    u32 lod_error_bits = 0;
+    std::memcpy(&lod_error_bits, &lod_error, sizeof(lod_error));
+
+    const u32 values[] = {
+        u32(texture_compression),
+        u32(mip_filter),
+        u32(optimize_meshes),
+        u32(compact_vertices),
+        u32(build_meshlets),
+        mesh_lods,
+        lod_error_bits,
+    };
+    return hash_bytes(values, sizeof(values));
+}
+
+std::string SceneData::baked_file_name(const std::string& file_name) {
+    return file_name + ".baked";
+}
+
+Result<void> SceneData::bake(const std::string& file_name, u64 cache_key) const {
+    baked::Header header = {};
+    header.magic = baked::magic;
+    header.version = baked::version;
+    header.cache_key = cache_key;
+    header.mesh_count = u32(meshes.size());
+    header.image_count = u32(images.size());
+    header.material_count = u32(materials.size());
+    header.object_count = u32(objects.size());
+    header.light_count = u32(point_lights.size());
+
+    u64 offset = sizeof(baked::Header)
+        + meshes.size() * sizeof(baked::Mesh)
+        + images.size() * sizeof(baked::Image)
+        + materials.size() * sizeof(baked::Material)
+        + objects.size() * sizeof(baked::Object)
+        + point_lights.size() * sizeof(baked::Light);
+
+    auto allocate_blob = [&](size_t size) {
+        offset = baked::align_up(offset);
+        const baked::Blob blob = {offset, size};
+        offset += size;
+        return blob;
+    };
+
+    std::vector<baked::Mesh> baked_meshes;
+    for(const Mesh& mesh : meshes) {
+        baked::Mesh& m = baked_meshes.emplace_back();
+        m.vertices = allocate_blob(mesh.vertices.size());
+        m.indices = allocate_blob(mesh.indices.size());
+        m.meshlets = allocate_blob(mesh.meshlets.size() * sizeof(Meshlet));
+        m.lods = allocate_blob(mesh.lods.size() * sizeof(MeshLod));
+        m.hash = mesh.hash;
+        m.bounds = mesh.bounds;
+        m.vertex_format = u32(mesh.vertex_format);
+        m.dequantization = mesh.dequantization;
+        m.index_type = u32(mesh.index_type);
+        m.quantized_layout = mesh.quantized_layout;
+    }
+
+    std::vector<baked::Image> baked_images;
+    for(const Image& image : images) {
+        baked::Image& i = baked_images.emplace_back();
+        i.data = allocate_blob(image.data.size());
+        i.size = image.size;
+        i.format = u32(image.format);
+        i.mip_levels = image.mip_levels;
+    }
+
+    header.file_size = offset;
+
+
+    // Write to a temporary file first so an interrupted bake never leaves a truncated file behind
+    const std::string tmp_file_name = file_name + ".tmp";
+    FILE* file = std::fopen(tmp_file_name.c_str(), "wb");
+    if(!file) {
+        return {false};
+    }
+
+    bool ok = true;
+    u64 written = 0;
+    auto write = [&](const void* data, size_t size) {
+        if(size) {
+            ok = ok && std::fwrite(data, 1, size, file) == size;
+            written += size;
+        }
+    };
+    auto write_blob = [&](const baked::Blob& blob, const void* data) {
+        static constexpr u8 zeros[baked::blob_alignment] = {};
+        write(zeros, size_t(blob.offset - written));
+        write(data, size_t(blob.size));
+    };
+
+    write(&header, sizeof(header));
+    write(baked_meshes.data(), baked_meshes.size() * sizeof(baked::Mesh));
+    write(baked_images.data(), baked_images.size() * sizeof(baked::Image));
+    write(materials.data(), materials.size() * sizeof(baked::Material));
+    write(objects.data(), objects.size() * sizeof(baked::Object));
+    write(point_lights.data(), point_lights.size() * sizeof(baked::Light));
+
+    for(size_t i = 0; i != meshes.size(); ++i) {
+        write_blob(baked_meshes[i].vertices, meshes[i].vertices.data());
+        write_blob(baked_meshes[i].indices, meshes[i].indices.data());
+        write_blob(baked_meshes[i].meshlets, meshes[i].meshlets.data());
+        write_blob(baked_meshes[i].lods, meshes[i].lods.data());
+    }
+    for(size_t i = 0; i != images.size(); ++i) {
+        write_blob(baked_images[i].data, images[i].data.data());
+    }
+
+    ok = std::fclose(file) == 0 && ok;
+    DEBUG_ASSERT(!ok || written == header.file_size);
+
+    if(ok) {
+        std::remove(file_name.c_str());
+        ok = std::rename(tmp_file_name.c_str(), file_name.c_str()) == 0;
+    }
+
+    if(!ok) {
+        std::remove(tmp_file_name.c_str());
+    }
+
+    return {ok};
+}
+
+static bool is_valid_layout(const SceneData::Mesh& mesh) {
+    if(mesh.vertex_format != VertexFormat::Quantized) {
+        return true;
+    }
+    for(const QuantizedAttrib& attrib : mesh.quantized_layout.attribs) {
+        const size_t size = attrib.components * component_size(attrib.type);
+        if(attrib.components > 4 || (attrib.components && !size) || attrib.offset + size > mesh.quantized_layout.stride) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Result<SceneData> SceneData::from_baked(const std::string& file_name, u64 cache_key) {
+    auto mapped = MappedFile::map(file_name);
+    if(!mapped.is_ok) {
+        return {false, {}};
+    }
+
+    const auto file = std::make_shared<const MappedFile>(std::move(mapped.value));
+    const u8* file_data = file->data();
+    const size_t file_size = file->size();
+
+    baked::Header header = {};
+    if(file_size < sizeof(header)) {
+        return {false, {}};
+    }
+    std::memcpy(&header, file_data, sizeof(header));
+
+    if(header.magic != baked::magic || header.version != baked::version || header.cache_key != cache_key || header.file_size != file_size) {
+        return {false, {}};
+    }
+
+    size_t cursor = sizeof(header);
+    auto read_table = [&](auto& table, u32 count) {
+        using value_type = typename std::remove_reference_t<decltype(table)>::value_type;
+        const size_t size = size_t(count) * sizeof(value_type);
+        if(cursor + size > file_size) {
+            return false;
+        }
+        table.resize(count);
+        std::memcpy(static_cast<void*>(table.data()), file_data + cursor, size);
+        cursor += size;
+        return true;
+    };
+
+    auto read_blob = [&](const baked::Blob& blob, auto span_type) -> decltype(span_type) {
+        using value_type = typename decltype(span_type)::value_type;
+        if(blob.offset % baked::blob_alignment || blob.size % sizeof(value_type) || blob.offset + blob.size > file_size) {
+            return {};
+        }
+        return decltype(span_type)(reinterpret_cast<value_type*>(file_data + blob.offset), size_t(blob.size / sizeof(value_type)));
+    };
+
+    SceneData data;
+    data.storage = file;
+
+    std::vector<baked::Mesh> baked_meshes;
+    std::vector<baked::Image> baked_images;
+    if(!read_table(baked_meshes, header.mesh_count) ||
+       !read_table(baked_images, header.image_count) ||
+       !read_table(data.materials, header.material_count) ||
+       !read_table(data.objects, header.object_count) ||
+       !read_table(data.point_lights, header.light_count)) {
+        return {false, {}};
+    }
+
+    for(const baked::Mesh& m : baked_meshes) {
+        Mesh& mesh = data.meshes.emplace_back();
+        mesh.vertices = read_blob(m.vertices, Span<const u8>());
+        mesh.indices = read_blob(m.indices, Span<const u8>());
+        mesh.meshlets = read_blob(m.meshlets, Span<const Meshlet>());
+        mesh.lods = read_blob(m.lods, Span<const MeshLod>());
+        mesh.hash = size_t(m.hash);
+        mesh.bounds = m.bounds;
+        mesh.vertex_format = VertexFormat(m.vertex_format);
+        mesh.dequantization = m.dequantization;
+        mesh.index_type = IndexType(m.index_type);
+        mesh.quantized_layout = m.quantized_layout;
+
+        const size_t stride = mesh.vertex_format == VertexFormat::Quantized ? mesh.quantized_layout.stride : vertex_size(mesh.vertex_format);
+        if(m.vertex_format > u32(VertexFormat::Quantized) || !stride || !is_valid_layout(mesh) || mesh.vertices.is_empty() || mesh.vertices.size() % stride) {
+            return {false, {}};
+        }
+        if(m.index_type > u32(IndexType::U32) || mesh.indices.is_empty() || mesh.indices.size() % index_size(mesh.index_type)) {
+            return {false, {}};
+        }
+        if(m.meshlets.size != mesh.meshlets.size() * sizeof(Meshlet) || m.lods.size != mesh.lods.size() * sizeof(MeshLod)) {
+            return {false, {}};
+        }
+        const size_t index_count = mesh.indices.size() / index_size(mesh.index_type);
+        for(const Meshlet& meshlet : mesh.meshlets) {
+            if(meshlet.first_index > index_count || meshlet.index_count > index_count - meshlet.first_index) {
+                return {false, {}};
+            }
+        }
+        for(const MeshLod& lod : mesh.lods) {
+            if(lod.first_index > index_count || lod.index_count > index_count - lod.first_index) {
+                return {false, {}};
+            }
+        }
+    }
+
+    for(const baked::Image& i : baked_images) {
+        Image& image = data.images.emplace_back();
+        image.data = read_blob(i.data, Span<const u8>());
+        image.size = i.size;
+        image.format = ImageFormat(i.format);
+        image.mip_levels = i.mip_levels;
+        if(!image.mip_levels || image.mip_levels > Texture::mip_levels(image.size) || image.data.size() != image_byte_size(image.format, image.size, image.mip_levels)) {
+            return {false, {}};
+        }
+    }
+
+    for(const Object& object : data.objects) {
+        if(object.mesh >= data.meshes.size() || object.material >= i32(data.materials.size())) {
+            return {false, {}};
+        }
+    }
+
+    for(const Material& material : data.materials) {
+        if(material.albedo >= i32(data.images.size()) || material.normal >= i32(data.images.size())) {
+            return {false, {}};
+        }
+    }
+
+    return {true, std::move(data)};
+}
+
+}
@@ -0,0 +1,101 @@
+#ifndef SCENEDATA_H
+#define SCENEDATA_H
+
+#include <Vertex.h>
+#include <Meshlet.h>
+#include <MeshSimplification.h>
+#include <Bounds.h>
+#include <ImageFormat.h>
+#include <TextureCompression.h>
+
+#include <glm/matrix.hpp>
+
+#include <vector>
+#include <memory>
+
+namespace OM3D {
+
+// Processing applied when importing a scene, part of the baked scene cache key
+struct SceneImportSettings {
+    TextureCompression texture_compression = TextureCompression::Fast;
+    MipFilter mip_filter = MipFilter::Kaiser;
+    // Reorders indices and vertices for the post-transform cache, overdraw and vertex fetch
+    bool optimize_meshes = true;
+    // Stores meshes as CompactVertex instead of Vertex, rendered with the COMPACT_VERTEX shader variant
+    bool compact_vertices = false;
+    // Splits meshes into meshlets that can be culled individually when rendering
+    bool build_meshlets = true;
+    // Simplified versions of each mesh appended to its index buffer, see build_lods
+    u32 mesh_lods = 3;
+    float lod_error = 0.01f;
+
+    u64 hash() const;
+};
+
+// CPU side content of a scene, ready to be uploaded.
+// Mesh and image payloads are views into memory owned by `storage`:
+// either decoded data or a mapped baked scene file.
+struct SceneData : NonCopyable {
+    struct Mesh {
+        // Vertices laid out as described by vertex_format, indices as described by index_type
+        Span<const u8> vertices;
+        Span<const u8> indices;
+        VertexFormat vertex_format = VertexFormat::Float;
+        IndexType index_type = IndexType::U32;
+        PositionDequantization dequantization;
+        // Only used by VertexFormat::Quantized
+        QuantizedLayout quantized_layout;
+        // Empty if meshlets weren't built, only cover the full resolution mesh
+        Span<const Meshlet> meshlets;
+        // Index ranges from the most to the least detailed, empty if no LOD was built
+        Span<const MeshLod> lods;
+        size_t hash = 0;
+        MeshBounds bounds;
+    };
+
+    struct Image {
+        Span<const u8> data;
+        glm::uvec2 size = {};
+        ImageFormat format = ImageFormat::RGBA8_UNORM;
+        u32 mip_levels = 1;
+    };
+
+    struct Material {
+        i32 albedo = -1;
+        i32 normal = -1;
+    };
+
+    struct Object {
+        u32 mesh = 0;
+        i32 material = -1;
+        glm::mat4 transform = glm::mat4(1.0f);
+    };
+
+    struct Light {
+        glm::vec3 position = {};
+        float radius = 0.0f;
+        glm::vec3 color = {};
+    };
+
+    std::vector<Mesh> meshes;
+    std::vector<Image> images;
+    std::vector<Material> materials;
+    std::vector<Object> objects;
+    std::vector<Light> point_lights;
+
+    std::shared_ptr<const void> storage;
+
+
+    // Imports a glTF file, going through its baked version when it is up to date
+    static Result<SceneData> from_gltf(const std::string& file_name, const SceneImportSettings& settings = {});
+
+    // Maps a baked scene, fails if it is missing or doesn't match the cache key and format version
+    static Result<SceneData> from_baked(const std::string& file_name, u64 cache_key);
+    Result<void> bake(const std::string& file_name, u64 cache_key) const;
+
+    static std::string baked_file_name(const std::string& file_name);
+};
+
+}
+
+#endif // SCENEDATA_H
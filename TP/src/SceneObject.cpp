@@ -32,14 +32,22 @@ const glm::mat4& SceneObject::transform() const {
 
 bool SceneObject::in_frustum(const Frustum& frustum, const Camera& camera) const {
 
-    const auto object_positon = glm::vec3(_transform[3]);
+    // The sphere is cheaper to test, the box is tighter for elongated meshes
+    const BoundingSphere sphere = world_sphere();
+    if(!camera.in_frustum(frustum, sphere.center, sphere.radius)) {
+        return false;
+    }
+
+    const CenteredBox box = world_box();
+    return camera.in_frustum(frustum, box.center, box.extents);
+}
 
-    auto scale_x = glm::length(glm::vec3(_transform[0]));
-    auto scale_y = glm::length(glm::vec3(_transform[1]));
-    auto scale_z = glm::length(glm::vec3(_transform[2]));
-    auto max_scale = std::max(std::max(scale_x, scale_y), scale_z);
+BoundingSphere SceneObject::world_sphere() const {
+    return transform_sphere(_mesh->bounds, _transform);
+}
 
-    return camera.in_frustum(frustum, object_positon, _mesh->radius * max_scale);
+CenteredBox SceneObject::world_box() const {
+    return transform_aabb(_mesh->bounds, _transform);
 }
 
 }
@@ -22,6 +22,8 @@ class SceneObject : NonCopyable {
         const glm::mat4& transform() const;
 
         bool in_frustum(const Frustum& frustum, const Camera& camera) const;
+        BoundingSphere world_sphere() const;
+        CenteredBox world_box() const;
 
         const auto get_material() const { return _material; }
         const auto get_mesh() const { return _mesh; }
@@ -23,9 +23,9 @@ void SceneView::set_scene(const Scene* scene) {
     }
 }
 
-RenderInfo SceneView::render() const {
+RenderInfo SceneView::render(const RenderSettings& settings) const {
     if(_scene) {
-        return _scene->render(_camera);
+        return _scene->render(_camera, settings);
     }
     return {};
 }
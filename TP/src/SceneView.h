@@ -16,7 +16,7 @@ class SceneView {
         const Scene* scene() const;
         void set_scene(const Scene* scene);
 
-        RenderInfo render() const;
+        RenderInfo render(const RenderSettings& settings = {}) const;
 
     private:
         const Scene* _scene = nullptr;
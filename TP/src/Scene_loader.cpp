@@ -1,13 +1,27 @@
 #include "Scene.h"
+#include "SceneData.h"
+#include "AsyncSceneLoader.h"
 #include "StaticMesh.h"
 
 #include <glm/gtc/quaternion.hpp>
 
+#include <JobSystem.h>
+#include <MappedFile.h>
+#include <MeshoptDecoder.h>
+#include <MeshOptimization.h>
+#include <MipGeneration.h>
+#include <VertexCompression.h>
 #include <utils.h>
 
 #include <iostream>
+#include <filesystem>
+#include <map>
+#include <numeric>
+#include <algorithm>
+#include <cstring>
 
 #define TINYGLTF_IMPLEMENTATION
+#define TINYGLTF_NO_STB_IMAGE
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 #define TINYGLTF_NOEXCEPTION
 #include <tinygltf/tiny_gltf.h>
@@ -27,24 +41,73 @@ static size_t component_count(int type) {
     }
 }
 
-static bool decode_attrib_buffer(const tinygltf::Model& gltf, const std::string& name, const tinygltf::Accessor& accessor, Span<Vertex> vertices) {
-    const tinygltf::BufferView& buffer = gltf.bufferViews[accessor.bufferView];
+// Float, plus the integer types allowed by KHR_mesh_quantization (and core glTF for UVs and colors)
+static bool is_supported_attrib_type(const std::string& name, ComponentType type, bool normalized) {
+    switch(type) {
+        case ComponentType::Float:
+            return !normalized;
 
-    if(accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
-        std::cerr << "Unsupported component type (" << accessor.componentType << ") for \"" << name << "\"" << std::endl;
-        return false;
+        case ComponentType::Byte:
+        case ComponentType::UnsignedByte:
+        case ComponentType::Short:
+        case ComponentType::UnsignedShort:
+        break;
+
+        default:
+            return false;
+    }
+
+    if(name == "NORMAL" || name == "TANGENT") {
+        return normalized && (type == ComponentType::Byte || type == ComponentType::Short);
     }
+    if(name == "COLOR_0") {
+        return normalized && (type == ComponentType::UnsignedByte || type == ComponentType::UnsignedShort);
+    }
+    return true;
+}
+
+// Normalized integers map to [0, 1] (unsigned) or [-1, 1] (signed)
+static float read_component(const u8* data, ComponentType type, bool normalized) {
+    auto read = [&](auto value, float max) {
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? std::max(float(value) / max, -1.0f) : float(value);
+    };
+
+    switch(type) {
+        case ComponentType::Byte: return read(i8(0), 127.0f);
+        case ComponentType::UnsignedByte: return read(u8(0), 255.0f);
+        case ComponentType::Short: return read(i16(0), 32767.0f);
+        case ComponentType::UnsignedShort: return read(u16(0), 65535.0f);
+        case ComponentType::Float: {
+            float value = 0.0f;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+    }
+    return 0.0f;
+}
+
+// Decodes to float, and records the attribute's source type in `layout` so that it can be re-encoded as is
+static bool decode_attrib_buffer(const tinygltf::Model& gltf, const std::string& name, const tinygltf::Accessor& accessor, Span<Vertex> vertices, QuantizedLayout& layout) {
+    const tinygltf::BufferView& buffer = gltf.bufferViews[accessor.bufferView];
+
+    const ComponentType type = ComponentType(accessor.componentType);
+    const bool normalized = accessor.normalized;
 
     [[maybe_unused]]
     const size_t vertex_count = vertices.size();
 
-    auto decode_attribs =  [&](auto* vertex_elems) {
+    auto decode_attribs =  [&](auto* vertex_elems, u32 location) {
         using attrib_type = std::remove_reference_t<decltype(vertex_elems[0])>;
         using value_type = typename attrib_type::value_type;
         static constexpr size_t size = sizeof(attrib_type) / sizeof(value_type);
 
+        if(!is_supported_attrib_type(name, type, normalized)) {
+            std::cerr << "Unsupported component type (" << accessor.componentType << (normalized ? ", normalized" : "") << ") for \"" << name << "\"" << std::endl;
+            return false;
+        }
+
         const size_t components = component_count(accessor.type);
-        const bool normalize = accessor.normalized;
 
         DEBUG_ASSERT(accessor.count == vertex_count);
 
@@ -53,82 +116,77 @@ static bool decode_attrib_buffer(const tinygltf::Model& gltf, const std::string&
         }
 
         const size_t min_size = std::min(size, components);
-        auto convert = [=](const u8* data) {
-            attrib_type vec;
-            for(size_t i = 0; i != min_size; ++i) {
-                vec[int(i)] = reinterpret_cast<const value_type*>(data)[i];
-            }
-            if(normalize) {
-                if constexpr(size == 4) {
-                    const glm::vec3 n = glm::normalize(glm::vec3(vec));
-                    vec[0] = n[0];
-                    vec[1] = n[1];
-                    vec[2] = n[2];
-                } else {
-                    vec = glm::normalize(vec);
-                }
-            }
-            return vec;
-        };
+        layout.attribs[location] = {type, u8(min_size), u8(normalized), 0};
 
         {
             u8* out_begin = reinterpret_cast<u8*>(vertex_elems);
 
             const auto& in_buffer = gltf.buffers[buffer.buffer].data;
             const u8* in_begin = in_buffer.data() + buffer.byteOffset + accessor.byteOffset;
-            const size_t attrib_size = components * sizeof(value_type);
+            const size_t elem_size = component_size(type);
+            const size_t attrib_size = components * elem_size;
             const size_t input_stride = buffer.byteStride ? buffer.byteStride : attrib_size;
 
             for(size_t i = 0; i != accessor.count; ++i) {
                 const u8* attrib = in_begin + i * input_stride;
-                DEBUG_ASSERT(attrib < in_buffer.data() + in_buffer.size());
-                *reinterpret_cast<attrib_type*>(out_begin + i * sizeof(Vertex)) = convert(attrib);
+                DEBUG_ASSERT(attrib + attrib_size <= in_buffer.data() + in_buffer.size());
+
+                attrib_type& vec = *reinterpret_cast<attrib_type*>(out_begin + i * sizeof(Vertex));
+                for(size_t c = 0; c != min_size; ++c) {
+                    vec[int(c)] = read_component(attrib + c * elem_size, type, normalized);
+                }
             }
         }
+        return true;
     };
 
     if(name == "POSITION") {
-        decode_attribs(&vertices[0].position);
+        return decode_attribs(&vertices[0].position, 0);
     } else if(name == "NORMAL") {
-        decode_attribs(&vertices[0].normal);
-    } else if(name == "TANGENT") {
-        decode_attribs(&vertices[0].tangent_bitangent_sign);
+        return decode_attribs(&vertices[0].normal, 1);
     } else if(name == "TEXCOORD_0") {
-        decode_attribs(&vertices[0].uv);
+        return decode_attribs(&vertices[0].uv, 2);
+    } else if(name == "TANGENT") {
+        return decode_attribs(&vertices[0].tangent_bitangent_sign, 3);
     } else if(name == "COLOR_0") {
-        decode_attribs(&vertices[0].color);
+        return decode_attribs(&vertices[0].color, 4);
     } else {
         std::cerr << "Attribute \"" << name << "\" is not supported" << std::endl;
     }
     return true;
 }
 
-static bool decode_index_buffer(const tinygltf::Model& gltf, const tinygltf::Accessor& accessor, Span<u32> indices) {
+// 16 bit indices are also returned as is in `indices16` if it isn't null, for meshes whose indices aren't rewritten
+static bool decode_index_buffer(const tinygltf::Model& gltf, const tinygltf::Accessor& accessor, Span<u32> indices, std::vector<u16>* indices16) {
     const tinygltf::BufferView& buffer = gltf.bufferViews[accessor.bufferView];
 
-    auto decode_indices = [&](u32 elem_size, auto convert_index) {
+    auto decode_indices = [&](u32 elem_size, auto* out, auto convert_index) {
         const u8* in_buffer = gltf.buffers[buffer.buffer].data.data() + buffer.byteOffset + accessor.byteOffset;
         const size_t input_stride = buffer.byteStride ? buffer.byteStride : elem_size;
 
         for(size_t i = 0; i != accessor.count; ++i) {
-            indices[i] = convert_index(in_buffer + i * input_stride);
+            out[i] = convert_index(in_buffer + i * input_stride);
         }
     };
 
     switch(accessor.componentType) {
         case TINYGLTF_PARAMETER_TYPE_BYTE:
         case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
-            decode_indices(1, [](const u8* data) -> u32 { return *data; });
+            decode_indices(1, indices.data(), [](const u8* data) -> u32 { return *data; });
         break;
 
         case TINYGLTF_PARAMETER_TYPE_SHORT:
         case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
-            decode_indices(2, [](const u8* data) -> u32 { return *reinterpret_cast<const u16*>(data); });
+            decode_indices(2, indices.data(), [](const u8* data) -> u32 { return *reinterpret_cast<const u16*>(data); });
+            if(indices16) {
+                indices16->resize(accessor.count);
+                decode_indices(2, indices16->data(), [](const u8* data) -> u16 { return *reinterpret_cast<const u16*>(data); });
+            }
         break;
 
         case TINYGLTF_PARAMETER_TYPE_INT:
         case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
-            decode_indices(4, [](const u8* data) -> u32 { return *reinterpret_cast<const u32*>(data); });
+            decode_indices(4, indices.data(), [](const u8* data) -> u32 { return *reinterpret_cast<const u32*>(data); });
         break;
 
         default:
@@ -139,7 +197,48 @@ static bool decode_index_buffer(const tinygltf::Model& gltf, const tinygltf::Acc
     return true;
 }
 
-static Result<MeshData> build_mesh_data(const tinygltf::Model& gltf, const tinygltf::Primitive& prim) {
+// Attribute locations of the QuantizedLayout, -1 for attributes that aren't imported
+static int attrib_location(const std::string& name) {
+    if(name == "POSITION") {
+        return 0;
+    } else if(name == "NORMAL") {
+        return 1;
+    } else if(name == "TEXCOORD_0") {
+        return 2;
+    } else if(name == "TANGENT") {
+        return 3;
+    } else if(name == "COLOR_0") {
+        return 4;
+    }
+    return -1;
+}
+
+// Interleaves the source bytes of the attributes into the packed `layout`, for vertices that weren't rewritten
+static std::vector<u8> copy_quantized_vertices(const tinygltf::Model& gltf, const tinygltf::Primitive& prim, size_t vertex_count, const QuantizedLayout& layout) {
+    std::vector<u8> quantized(vertex_count * layout.stride, 0);
+    for(auto&& [name, id] : prim.attributes) {
+        const int location = attrib_location(name);
+        if(location < 0 || !layout.attribs[location].components) {
+            continue;
+        }
+
+        const tinygltf::Accessor& accessor = gltf.accessors[id];
+        const tinygltf::BufferView& buffer = gltf.bufferViews[accessor.bufferView];
+        const QuantizedAttrib& attrib = layout.attribs[location];
+
+        const u8* in_begin = gltf.buffers[buffer.buffer].data.data() + buffer.byteOffset + accessor.byteOffset;
+        const size_t attrib_size = component_count(accessor.type) * component_size(attrib.type);
+        const size_t input_stride = buffer.byteStride ? buffer.byteStride : attrib_size;
+        const size_t copy_size = attrib.components * component_size(attrib.type);
+
+        for(size_t i = 0; i != vertex_count; ++i) {
+            std::memcpy(quantized.data() + i * layout.stride + attrib.offset, in_begin + i * input_stride, copy_size);
+        }
+    }
+    return quantized;
+}
+
+static Result<MeshData> build_mesh_data(const tinygltf::Model& gltf, const tinygltf::Primitive& prim, QuantizedLayout& layout, std::vector<u16>* indices16) {
     std::vector<Vertex> vertices;
     for(auto&& [name, id] : prim.attributes) {
         tinygltf::Accessor accessor = gltf.accessors[id];
@@ -157,7 +256,7 @@ static Result<MeshData> build_mesh_data(const tinygltf::Model& gltf, const tinyg
             return {false, {}};
         }
 
-        if(!decode_attrib_buffer(gltf, name, accessor, vertices)) {
+        if(!decode_attrib_buffer(gltf, name, accessor, vertices, layout)) {
             return {false, {}};
         }
     }
@@ -176,7 +275,7 @@ static Result<MeshData> build_mesh_data(const tinygltf::Model& gltf, const tinyg
             return {false, {}};
         }
 
-        if(!decode_index_buffer(gltf, accessor, indices)) {
+        if(!decode_index_buffer(gltf, accessor, indices, indices16)) {
             return {false, {}};
         }
     }
@@ -184,31 +283,78 @@ static Result<MeshData> build_mesh_data(const tinygltf::Model& gltf, const tinyg
     return {true, MeshData{std::move(vertices), std::move(indices)}};
 }
 
-static Result<TextureData> build_texture_data(const tinygltf::Image& image, bool as_sRGB) {
-    if(image.bits != 8 && image.pixel_type != TINYGLTF_COMPONENT_TYPE_BYTE && image.pixel_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-        std::cerr << "Unsupported image format (pixel type)" << std::endl;
-        return {false, {}};
+// Encoded image payload, recorded while parsing and decoded later on worker threads
+struct EncodedImage {
+    // Images stored in a buffer view are read in place from the glTF buffers
+    int buffer_view = -1;
+    // Images from URIs are only alive during parsing and have to be kept
+    std::vector<u8> bytes;
+};
+
+static bool record_encoded_image(tinygltf::Image* image, const int image_index, std::string*, std::string*, int, int, const unsigned char* bytes, int size, void* user_data) {
+    auto& encoded_images = *static_cast<std::vector<EncodedImage>*>(user_data);
+    if(encoded_images.size() <= size_t(image_index)) {
+        encoded_images.resize(image_index + 1);
     }
 
-    ImageFormat format = ImageFormat::RGBA8_UNORM;
-    switch(image.component) {
-        case 3:
-            format = as_sRGB ? ImageFormat::RGB8_sRGB : ImageFormat::RGB8_UNORM;
-        break;
+    EncodedImage& encoded = encoded_images[image_index];
+    encoded.buffer_view = image->bufferView;
+    if(encoded.buffer_view < 0) {
+        encoded.bytes.assign(bytes, bytes + size);
+    }
+    return true;
+}
 
-        case 4:
-            format = as_sRGB ? ImageFormat::RGBA8_sRGB : ImageFormat::RGBA8_UNORM;
-        break;
+static Span<const u8> encoded_image_bytes(const tinygltf::Model& gltf, const EncodedImage& encoded) {
+    if(encoded.buffer_view < 0) {
+        return encoded.bytes;
+    }
 
-        default:
-            std::cerr << "Unsupported image format (components)" << std::endl;
-            return {false, {}};
+    const tinygltf::BufferView& view = gltf.bufferViews[encoded.buffer_view];
+    return Span<const u8>(gltf.buffers[view.buffer].data.data() + view.byteOffset, view.byteLength);
+}
+
+// Thread safe: pixels are decoded to RGBA8 and moved into the TextureData as is
+static Result<TextureData> build_texture_data(Span<const u8> encoded, bool as_sRGB) {
+    auto texture = TextureData::from_memory(encoded);
+    if(texture.is_ok && as_sRGB) {
+        texture.value.format = ImageFormat::RGBA8_sRGB;
+    }
+    return texture;
+}
+
+// Image referenced by a material, imported on a worker thread
+struct ImageImport {
+    int source = -1;
+    bool as_sRGB = false;
+    bool is_normal_map = false;
+
+    Result<TextureData> texture = {false, {}};
+    double decode_time = 0.0;
+    double mips_time = 0.0;
+    double compression_time = 0.0;
+};
+
+// Thread safe: decodes the image, then builds its full mip chain and compresses it so that every level is uploaded as is
+static void import_image(Span<const u8> encoded, const SceneImportSettings& settings, ImageImport& image) {
+    double start = program_time();
+    image.texture = build_texture_data(encoded, image.as_sRGB);
+    image.decode_time = program_time() - start;
+    if(!image.texture.is_ok) {
+        return;
     }
 
-    auto data = std::make_unique<u8[]>(image.image.size());
-    std::copy(image.image.begin(), image.image.end(), data.get());
+    start = program_time();
+    if(auto r = generate_mips(image.texture.value, settings.mip_filter, image.is_normal_map); r.is_ok) {
+        image.texture.value = std::move(r.value);
+    }
+    image.mips_time = program_time() - start;
 
-    return {true, TextureData{std::move(data), glm::uvec2(image.width, image.height), format}};
+    start = program_time();
+    if(auto r = compress_texture(image.texture.value, image.is_normal_map, settings.texture_compression, settings.mip_filter); r.is_ok) {
+        image.texture.value = std::move(r.value);
+    }
+    image.compression_time = program_time() - start;
 }
 
 
@@ -285,21 +431,323 @@ static void compute_tangents(MeshData& mesh) {
     }
 }
 
-Result<std::unique_ptr<Scene>> Scene::from_gltf(const std::string& file_name, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines) {
+struct DecodedPrimitive {
+    Result<MeshData> data = {false, {}};
+    size_t hash = 0;
+    MeshBounds bounds;
+
+    VertexCacheStats cache_stats_before;
+    VertexCacheStats cache_stats_after;
+
+    // Only used when importing with compact vertices
+    CompactVertexData compact;
+    // Only used for KHR_mesh_quantization primitives, when not importing with compact vertices
+    QuantizedLayout quantized_layout;
+    std::vector<u8> quantized_vertices;
+    // Only used when every index fits in 16 bits
+    std::vector<u16> indices16;
+    // Only used when importing with meshlets
+    std::vector<Meshlet> meshlets;
+    // Only used when importing with LODs, the first one is the full mesh
+    std::vector<MeshLod> lods;
+};
+
+// Thread safe: only reads from gltf
+static DecodedPrimitive decode_primitive(const tinygltf::Model& gltf, const tinygltf::Primitive& prim, const SceneImportSettings& settings) {
+    DecodedPrimitive decoded;
+    QuantizedLayout& layout = decoded.quantized_layout;
+    // Optimizing and building LODs rewrite the indices, which are then narrowed from the final 32 bit ones
+    const bool keeps_indices = !settings.optimize_meshes && !settings.mesh_lods;
+    decoded.data = build_mesh_data(gltf, prim, layout, keeps_indices ? &decoded.indices16 : nullptr);
+    if(!decoded.data.is_ok) {
+        return decoded;
+    }
+
+    // Quantized attributes are decoded for processing, and copied or encoded back to their source types once done
+    const bool quantized = std::any_of(std::begin(layout.attribs), std::end(layout.attribs), [](const QuantizedAttrib& attrib) {
+        return attrib.components && attrib.type != ComponentType::Float;
+    });
+
+    MeshData& mesh = decoded.data.value;
+    const bool generates_tangents = mesh.vertices[0].tangent_bitangent_sign == glm::vec4(0.0f);
+    if(generates_tangents) {
+        compute_tangents(mesh);
+        layout.attribs[3] = {ComponentType::Short, 4, true, 0};
+    }
+
+    decoded.cache_stats_before = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+    if(settings.optimize_meshes) {
+        optimize_mesh(mesh);
+    }
+    decoded.cache_stats_after = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+
+    // Built from the final index order, since meshlets are ranges of the index buffer
+    if(settings.build_meshlets) {
+        decoded.meshlets = build_meshlets(mesh.vertices, mesh.indices);
+    }
+
+    // LODs share the vertices, and are appended to the indices
+    if(settings.mesh_lods) {
+        decoded.lods = build_lods(mesh.vertices, mesh.indices, settings.mesh_lods, settings.lod_error, settings.optimize_meshes);
+    }
+
+    decoded.hash = mesh.hash();
+    decoded.bounds = mesh.bounds();
+
+    if(settings.compact_vertices) {
+        decoded.compact = compress_vertices(mesh.vertices);
+    } else if(quantized) {
+        // Source bytes are uploaded as is, unless generated tangents or the vertex fetch optimization changed them
+        pack_quantized_layout(layout);
+        decoded.quantized_vertices = generates_tangents || settings.optimize_meshes
+            ? quantize_vertices(mesh.vertices, layout)
+            : copy_quantized_vertices(gltf, prim, mesh.vertices.size(), layout);
+    }
+
+    // Indices stay 32 bit while processing the mesh. 16 bit source indices were kept as is if nothing rewrote them,
+    // other ones are narrowed if the vertex count allows it
+    if(decoded.indices16.empty()) {
+        decoded.indices16 = mesh.narrow_indices();
+    }
+    return decoded;
+}
+
+// Buffers that only exist as a fallback for EXT_meshopt_compression have no data, which tinygltf fails to parse.
+// They are given a one byte placeholder before parsing, and sized to hold the decoded buffer views afterward.
+struct FallbackBuffer {
+    size_t index;
+    size_t byte_length;
+};
+
+static bool patch_fallback_buffers(std::string& json_text, std::vector<FallbackBuffer>& fallbacks) {
+    if(json_text.find("EXT_meshopt_compression") == std::string::npos) {
+        return false;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(json_text.begin(), json_text.end(), nullptr, false);
+    if(!json.is_object()) {
+        return false;
+    }
+
+    const auto buffers = json.find("buffers");
+    if(buffers == json.end() || !buffers->is_array()) {
+        return false;
+    }
+
+    for(size_t i = 0; i != buffers->size(); ++i) {
+        nlohmann::json& buffer = (*buffers)[i];
+        if(!buffer.is_object() || buffer.count("uri")) {
+            continue;
+        }
+
+        const auto extensions = buffer.find("extensions");
+        if(extensions == buffer.end() || !extensions->is_object()) {
+            continue;
+        }
+        const auto meshopt = extensions->find("EXT_meshopt_compression");
+        if(meshopt == extensions->end() || !meshopt->is_object()) {
+            continue;
+        }
+        const auto fallback = meshopt->find("fallback");
+        const auto byte_length = buffer.find("byteLength");
+        if(fallback == meshopt->end() || !fallback->is_boolean() || !fallback->get<bool>() || byte_length == buffer.end() || !byte_length->is_number_unsigned()) {
+            continue;
+        }
+
+        fallbacks.push_back(FallbackBuffer{i, byte_length->get<size_t>()});
+        buffer["uri"] = "data:application/octet-stream;base64,AA==";
+        buffer["byteLength"] = 1;
+    }
+
+    if(fallbacks.empty()) {
+        return false;
+    }
+
+    json_text = json.dump();
+    return true;
+}
+
+// The whole source of a .gltf, the JSON chunk of a .glb. Empty if the GLB header is invalid
+static Span<const u8> gltf_json(Span<const u8> source, bool is_ascii) {
+    if(is_ascii) {
+        return source;
+    }
+
+    // GLB: 12 byte header, followed by the JSON chunk and the binary chunk
+    if(source.size() < 20) {
+        return {};
+    }
+
+    u32 json_length = 0;
+    std::memcpy(&json_length, source.data() + 12, sizeof(json_length));
+    if(20 + size_t(json_length) > source.size()) {
+        return {};
+    }
+    return Span<const u8>(source.data() + 20, json_length);
+}
+
+// Returns the source with its fallback buffers patched, or nothing if it has none
+static std::vector<u8> patch_fallback_buffers(Span<const u8> source, bool is_ascii, std::vector<FallbackBuffer>& fallbacks) {
+    const Span<const u8> json = gltf_json(source, is_ascii);
+    std::string json_text(json.begin(), json.end());
+    if(json_text.empty() || !patch_fallback_buffers(json_text, fallbacks)) {
+        return {};
+    }
+
+    if(is_ascii) {
+        return std::vector<u8>(json_text.begin(), json_text.end());
+    }
+
+    const u32 json_length = u32(json.size());
+
+    // Chunks are 4 byte aligned, the JSON one is padded with spaces
+    json_text.resize((json_text.size() + 3) / 4 * 4, ' ');
+    const u32 patched_json_length = u32(json_text.size());
+    const u32 total_length = u32(source.size() - json_length + patched_json_length);
+
+    std::vector<u8> patched(total_length);
+    std::memcpy(patched.data(), source.data(), 20);
+    std::memcpy(patched.data() + 8, &total_length, sizeof(total_length));
+    std::memcpy(patched.data() + 12, &patched_json_length, sizeof(patched_json_length));
+    std::memcpy(patched.data() + 20, json_text.data(), json_text.size());
+    std::memcpy(patched.data() + 20 + patched_json_length, source.data() + 20 + json_length, source.size() - 20 - json_length);
+    return patched;
+}
+
+static Result<MeshoptMode> parse_meshopt_mode(const std::string& mode) {
+    if(mode == "ATTRIBUTES") {
+        return {true, MeshoptMode::Attributes};
+    }
+    if(mode == "TRIANGLES") {
+        return {true, MeshoptMode::Triangles};
+    }
+    if(mode == "INDICES") {
+        return {true, MeshoptMode::Indices};
+    }
+    return {false, {}};
+}
+
+static Result<MeshoptFilter> parse_meshopt_filter(const std::string& filter) {
+    if(filter.empty() || filter == "NONE") {
+        return {true, MeshoptFilter::None};
+    }
+    if(filter == "OCTAHEDRAL") {
+        return {true, MeshoptFilter::Octahedral};
+    }
+    if(filter == "QUATERNION") {
+        return {true, MeshoptFilter::Quaternion};
+    }
+    if(filter == "EXPONENTIAL") {
+        return {true, MeshoptFilter::Exponential};
+    }
+    return {false, {}};
+}
+
+// Decodes every EXT_meshopt_compression buffer view in place, in parallel. Returns the number of bytes decoded
+static Result<size_t> decode_meshopt_buffer_views(tinygltf::Model& gltf) {
+    struct MeshoptView {
+        size_t index;
+        Span<const u8> encoded;
+        MeshoptMode mode;
+        MeshoptFilter filter;
+        size_t count;
+        size_t stride;
+        Span<u8> out;
+    };
+
+    std::vector<MeshoptView> views;
+    for(size_t i = 0; i != gltf.bufferViews.size(); ++i) {
+        const tinygltf::BufferView& view = gltf.bufferViews[i];
+        const auto it = view.extensions.find("EXT_meshopt_compression");
+        if(it == view.extensions.end()) {
+            continue;
+        }
+
+        const tinygltf::Value& extension = it->second;
+        auto get_size = [&](const char* key) {
+            return extension.Has(key) && extension.Get(key).IsNumber() ? size_t(extension.Get(key).GetNumberAsDouble()) : size_t(0);
+        };
+        auto get_string = [&](const char* key) {
+            return extension.Has(key) && extension.Get(key).IsString() ? extension.Get(key).Get<std::string>() : std::string();
+        };
+
+        const size_t buffer = get_size("buffer");
+        const size_t byte_offset = get_size("byteOffset");
+        const size_t byte_length = get_size("byteLength");
+        const size_t stride = get_size("byteStride");
+        const size_t count = get_size("count");
+        const auto mode = parse_meshopt_mode(get_string("mode"));
+        const auto filter = parse_meshopt_filter(get_string("filter"));
+
+        const bool valid = mode.is_ok && filter.is_ok
+                && view.buffer >= 0 && size_t(view.buffer) < gltf.buffers.size()
+                && buffer < gltf.buffers.size() && byte_offset + byte_length <= gltf.buffers[buffer].data.size()
+                && view.byteOffset + count * stride <= gltf.buffers[view.buffer].data.size();
+        if(!valid) {
+            std::cerr << "Invalid EXT_meshopt_compression buffer view (" << i << ")" << std::endl;
+            return {false, 0};
+        }
+
+        MeshoptView& decoded = views.emplace_back();
+        decoded.index = i;
+        decoded.encoded = Span<const u8>(gltf.buffers[buffer].data.data() + byte_offset, byte_length);
+        decoded.mode = mode.value;
+        decoded.filter = filter.value;
+        decoded.count = count;
+        decoded.stride = stride;
+        decoded.out = Span<u8>(gltf.buffers[view.buffer].data.data() + view.byteOffset, count * stride);
+    }
+
+    std::vector<u8> decoded(views.size(), false);
+    parallel_for(views.size(), [&](size_t i) {
+        const MeshoptView& view = views[i];
+        decoded[i] = decode_meshopt_buffer(view.encoded, view.mode, view.filter, view.count, view.stride, view.out).is_ok;
+    });
+
+    size_t decoded_bytes = 0;
+    for(size_t i = 0; i != views.size(); ++i) {
+        if(!decoded[i]) {
+            std::cerr << "Unable to decode EXT_meshopt_compression buffer view (" << views[i].index << ")" << std::endl;
+            return {false, 0};
+        }
+        decoded_bytes += views[i].out.size();
+    }
+
+    return {true, decoded_bytes};
+}
+
+// Owns the decoded payloads viewed by SceneData
+struct DecodedSceneStorage {
+    std::vector<DecodedPrimitive> primitives;
+    std::vector<TextureData> images;
+};
+
+static Result<SceneData> import_gltf(const std::string& file_name, Span<const u8> source, const SceneImportSettings& settings) {
     const double time = program_time();
-    DEFER(std::cout << file_name << " loaded in " << std::round((program_time() - time) * 100.0) / 100.0 << "s" << std::endl);
 
     tinygltf::TinyGLTF ctx;
     tinygltf::Model gltf;
 
+    // Images are not decoded during parsing: only their encoded bytes are recorded
+    std::vector<EncodedImage> encoded_images;
+    ctx.SetImageLoader(record_encoded_image, &encoded_images);
+
     {
         std::string err;
         std::string warn;
 
+        const std::string base_dir = std::filesystem::path(file_name).parent_path().string();
         const bool is_ascii = ends_with(file_name, ".gltf");
+
+        std::vector<FallbackBuffer> fallback_buffers;
+        const std::vector<u8> patched_source = patch_fallback_buffers(source, is_ascii, fallback_buffers);
+        if(!patched_source.empty()) {
+            source = patched_source;
+        }
+
         const bool ok = is_ascii
-                ? ctx.LoadASCIIFromFile(&gltf, &err, &warn, file_name)
-                : ctx.LoadBinaryFromFile(&gltf, &err, &warn, file_name);
+                ? ctx.LoadASCIIFromString(&gltf, &err, &warn, reinterpret_cast<const char*>(source.data()), u32(source.size()), base_dir)
+                : ctx.LoadBinaryFromMemory(&gltf, &err, &warn, source.data(), u32(source.size()), base_dir);
 
         if(!err.empty()) {
             std::cerr << "Error while loading gltf: " << err << std::endl;
@@ -311,14 +759,19 @@ Result<std::unique_ptr<Scene>> Scene::from_gltf(const std::string& file_name, co
         if(!ok) {
             return {false, {}};
         }
+
+        for(const FallbackBuffer& fallback : fallback_buffers) {
+            gltf.buffers[fallback.index].data.assign(fallback.byte_length, 0);
+        }
     }
 
     std::cout << file_name << " parsed in " << std::round((program_time() - time) * 100.0) / 100.0 << "s" << std::endl;
 
-    auto scene = std::make_unique<Scene>();
+    SceneData scene;
+    auto storage = std::make_shared<DecodedSceneStorage>();
 
-    std::unordered_map<int, std::shared_ptr<Texture>> textures;
-    std::unordered_map<int, std::shared_ptr<Material>> materials;
+    std::unordered_map<int, i32> images;
+    std::unordered_map<int, i32> materials;
     std::unordered_map<int, glm::mat4> node_transforms;
 
     {
@@ -337,6 +790,14 @@ Result<std::unique_ptr<Scene>> Scene::from_gltf(const std::string& file_name, co
         }
     }
 
+    // Every (mesh, primitive) pair is decoded and uploaded once, and shared by all the nodes that reference it
+    std::map<std::pair<int, size_t>, size_t> primitive_cache;
+    std::vector<const tinygltf::Primitive*> primitives;
+    std::vector<std::string> primitive_names;
+
+    // Primitive instances to create, in scene order
+    std::vector<std::pair<size_t, glm::mat4>> instances;
+
     for(auto [node_index, node_transform] : node_transforms) {
         const tinygltf::Node& node = gltf.nodes[node_index];
 
@@ -350,68 +811,12 @@ Result<std::unique_ptr<Scene>> Scene::from_gltf(const std::string& file_name, co
                     continue;
                 }
 
-                auto mesh = build_mesh_data(gltf, prim);
-                if(!mesh.is_ok) {
-                    return {false, {}};
-                }
-
-                if(mesh.value.vertices[0].tangent_bitangent_sign == glm::vec4(0.0f)) {
-                    compute_tangents(mesh.value);
-                }
-
-                std::shared_ptr<Material> material;
-                if(prim.material >= 0) {
-                    auto& mat = materials[prim.material];
-
-                    if(!mat) {
-                        const auto& albedo_info = gltf.materials[prim.material].pbrMetallicRoughness.baseColorTexture;
-                        const auto& normal_info = gltf.materials[prim.material].normalTexture;
-
-                        auto load_texture = [&](auto texture_info, bool as_sRGB) -> std::shared_ptr<Texture> {
-                            if(texture_info.texCoord != 0) {
-                                std::cerr << "Unsupported texture coordinate channel (" << texture_info.texCoord << ")" << std::endl;
-                                return nullptr;
-                            }
-
-                            if(texture_info.index < 0) {
-                                return nullptr;
-                            }
-
-                            const int index = gltf.textures[texture_info.index].source;
-                            if(index < 0) {
-                                return nullptr;
-                            }
-
-                            auto& texture = textures[index];
-                            if(!texture) {
-                                if(const auto r = build_texture_data(gltf.images[index], as_sRGB); r.is_ok) {
-                                    texture = std::make_shared<Texture>(r.value);
-                                }
-                            }
-                            return texture;
-                        };
-
-                        auto albedo = load_texture(albedo_info, true);
-                        auto normal = load_texture(normal_info, false);
-
-                        if(!albedo) {
-                            mat = Material::material(pipeline, defines);
-                        } else if(!normal) {
-                            mat = Material::textured_material(pipeline, defines);
-                            mat->set_texture(0u, albedo);
-                        } else {
-                            mat = Material::textured_normal_mapped_material(pipeline, defines);
-                            mat->set_texture(0u, albedo);
-                            mat->set_texture(1u, normal);
-                        }
-                    }
-
-                    material = mat;
+                const auto [it, inserted] = primitive_cache.try_emplace(std::pair{node.mesh, j}, primitives.size());
+                if(inserted) {
+                    primitives.push_back(&prim);
+                    primitive_names.push_back(mesh.primitives.size() > 1 ? mesh.name + "#" + std::to_string(j) : mesh.name);
                 }
-
-                auto scene_object = SceneObject(std::make_shared<StaticMesh>(mesh.value), std::move(material));
-                scene_object.set_transform(node_transform);
-                scene->add_object(std::move(scene_object));
+                instances.emplace_back(it->second, node_transform);
             }
 
         } else if (node.extensions.find("KHR_lights_punctual") != node.extensions.end()) {
@@ -421,29 +826,378 @@ Result<std::unique_ptr<Scene>> Scene::from_gltf(const std::string& file_name, co
             const auto& light_info = gltf.lights[light_index];
 
             if(light_info.type == "point") {
-                PointLight light;
-                light.set_position(node_transform[3]);
-                light.set_color(glm::vec3(light_info.color[0], light_info.color[1], light_info.color[2]));
+                SceneData::Light light;
+                light.position = node_transform[3];
+                light.color = glm::vec3(light_info.color[0], light_info.color[1], light_info.color[2]);
                 if (light_info.range > 0.0f) {
-                    light.set_radius((float)light_info.range);
+                    light.radius = (float)light_info.range;
                 } else {
                     // Consider that when E <= 1, lights has reached it's max range (with E = I/d^2)
                     // I <= d^2, so d = sqrt(I)
-                    light.set_radius((float)std::sqrt(light_info.intensity));
+                    light.radius = (float)std::sqrt(light_info.intensity);
                 }
-                scene->add_object(std::move(light));
+                scene.point_lights.push_back(light);
             } else {
                 std::cerr << "Unsupported light type: " << light_info.type << std::endl;
             }
         }
     }
 
+    // Images used by materials, in texture order
+    std::vector<ImageImport> image_imports;
+    std::vector<size_t> instance_counts(primitives.size());
+
+    for(const auto& [primitive_index, transform] : instances) {
+        const tinygltf::Primitive& prim = *primitives[primitive_index];
+
+        i32 material = -1;
+        if(prim.material >= 0) {
+            const auto [it, inserted] = materials.try_emplace(prim.material, i32(scene.materials.size()));
+            if(inserted) {
+                const auto& albedo_info = gltf.materials[prim.material].pbrMetallicRoughness.baseColorTexture;
+                const auto& normal_info = gltf.materials[prim.material].normalTexture;
+
+                auto load_image = [&](auto texture_info, bool as_sRGB, bool is_normal_map) -> i32 {
+                    if(texture_info.texCoord != 0) {
+                        std::cerr << "Unsupported texture coordinate channel (" << texture_info.texCoord << ")" << std::endl;
+                        return -1;
+                    }
+
+                    if(texture_info.index < 0) {
+                        return -1;
+                    }
+
+                    const int index = gltf.textures[texture_info.index].source;
+                    if(index < 0) {
+                        return -1;
+                    }
+
+                    if(size_t(index) >= encoded_images.size()) {
+                        std::cerr << "Image " << index << " has no data" << std::endl;
+                        return -1;
+                    }
+
+                    const auto [image_it, image_inserted] = images.try_emplace(index, i32(image_imports.size()));
+                    if(image_inserted) {
+                        ImageImport& image = image_imports.emplace_back();
+                        image.source = index;
+                        image.as_sRGB = as_sRGB;
+                        image.is_normal_map = is_normal_map;
+                    }
+                    return image_it->second;
+                };
+
+                SceneData::Material mat;
+                mat.albedo = load_image(albedo_info, true, false);
+                mat.normal = load_image(normal_info, false, true);
+                scene.materials.push_back(mat);
+            }
+
+            material = it->second;
+        }
+
+        ++instance_counts[primitive_index];
+        scene.objects.push_back(SceneData::Object{u32(primitive_index), material, transform});
+    }
+
+    // Import every image and primitive in parallel: this is pure CPU work, GL objects are created from the SceneData afterward.
+    // Compressed buffer views are decoded before any accessor is read, images that aren't in one are imported meanwhile.
+    // Images come first as they are usually the longest tasks.
+    std::vector<DecodedPrimitive>& decoded = storage->primitives;
+    decoded.resize(primitives.size());
+    std::vector<double> decode_times(primitives.size());
+    {
+        Result<size_t> meshopt_bytes = {true, 0};
+        double meshopt_time = 0.0;
+
+        TaskGraph import_graph;
+        const TaskGraph::TaskId meshopt_task = import_graph.add([&] {
+            const double decode_start = program_time();
+            meshopt_bytes = decode_meshopt_buffer_views(gltf);
+            meshopt_time = program_time() - decode_start;
+        });
+
+        for(ImageImport& image : image_imports) {
+            const int buffer_view = encoded_images[image.source].buffer_view;
+            const bool compressed = buffer_view >= 0 && gltf.bufferViews[buffer_view].extensions.count("EXT_meshopt_compression");
+            import_graph.add([&] {
+                import_image(encoded_image_bytes(gltf, encoded_images[image.source]), settings, image);
+            }, compressed ? Span<const TaskGraph::TaskId>(meshopt_task) : Span<const TaskGraph::TaskId>());
+        }
+
+        // Primitives are left undecoded if the buffer views failed to decode
+        for(size_t prim = 0; prim != primitives.size(); ++prim) {
+            import_graph.add([&, prim] {
+                if(!meshopt_bytes.is_ok) {
+                    return;
+                }
+                const double decode_start = program_time();
+                decoded[prim] = decode_primitive(gltf, *primitives[prim], settings);
+                decode_times[prim] = program_time() - decode_start;
+            }, meshopt_task);
+        }
+
+        import_graph.run();
+
+        if(!meshopt_bytes.is_ok) {
+            return {false, {}};
+        }
+        if(meshopt_bytes.value) {
+            std::cout << "EXT_meshopt_compression: " << std::round(meshopt_bytes.value / 1024.0 / 1024.0 * 100.0) / 100.0 << "MB decoded in "
+                      << std::round(meshopt_time * 1000.0 * 100.0) / 100.0 << "ms ("
+                      << std::round(meshopt_bytes.value / std::max(meshopt_time, 1e-9) / 1e9 * 100.0) / 100.0 << " GB/s)" << std::endl;
+        }
+    }
+
+    std::cout << primitives.size() << " primitives and " << image_imports.size() << " images imported in " << std::round((program_time() - time) * 100.0) / 100.0 << "s" << std::endl;
+
+    size_t vertex_bytes = 0;
+    size_t float_vertex_bytes = 0;
+    size_t index_bytes = 0;
+    size_t u32_index_bytes = 0;
+    size_t meshlet_count = 0;
+    std::vector<size_t> lod_triangles;
+    for(const DecodedPrimitive& mesh : decoded) {
+        if(!mesh.data.is_ok) {
+            return {false, {}};
+        }
+        SceneData::Mesh& scene_mesh = scene.meshes.emplace_back();
+        if(settings.compact_vertices) {
+            scene_mesh.vertices = mesh.compact.vertices;
+            scene_mesh.vertex_format = mesh.compact.format;
+            scene_mesh.dequantization = mesh.compact.dequantization;
+        } else if(!mesh.quantized_vertices.empty()) {
+            scene_mesh.vertices = mesh.quantized_vertices;
+            scene_mesh.vertex_format = VertexFormat::Quantized;
+            scene_mesh.quantized_layout = mesh.quantized_layout;
+        } else {
+            const std::vector<Vertex>& vertices = mesh.data.value.vertices;
+            scene_mesh.vertices = Span<const u8>(reinterpret_cast<const u8*>(vertices.data()), vertices.size() * sizeof(Vertex));
+        }
+        if(!mesh.indices16.empty()) {
+            scene_mesh.indices = Span<const u8>(reinterpret_cast<const u8*>(mesh.indices16.data()), mesh.indices16.size() * sizeof(u16));
+            scene_mesh.index_type = IndexType::U16;
+        } else {
+            const std::vector<u32>& indices = mesh.data.value.indices;
+            scene_mesh.indices = Span<const u8>(reinterpret_cast<const u8*>(indices.data()), indices.size() * sizeof(u32));
+            scene_mesh.index_type = IndexType::U32;
+        }
+        scene_mesh.meshlets = mesh.meshlets;
+        scene_mesh.lods = mesh.lods;
+        scene_mesh.hash = mesh.hash;
+        scene_mesh.bounds = mesh.bounds;
+
+        vertex_bytes += scene_mesh.vertices.size();
+        float_vertex_bytes += mesh.data.value.vertices.size() * sizeof(Vertex);
+        index_bytes += scene_mesh.indices.size();
+        u32_index_bytes += mesh.data.value.indices.size() * sizeof(u32);
+        meshlet_count += mesh.meshlets.size();
+        for(size_t i = 0; i != mesh.lods.size(); ++i) {
+            lod_triangles.resize(std::max(lod_triangles.size(), i + 1), 0);
+            lod_triangles[i] += mesh.lods[i].index_count / 3;
+        }
+    }
+
+    // Images that failed to decode are dropped, and the materials using them fall back to no texture
+    size_t texture_bytes = 0;
+    size_t uncompressed_texture_bytes = 0;
+    {
+        std::vector<i32> image_remap(image_imports.size(), -1);
+        for(size_t i = 0; i != image_imports.size(); ++i) {
+            ImageImport& image = image_imports[i];
+            if(!image.texture.is_ok) {
+                std::cerr << "Unable to decode image " << image.source << " (\"" << gltf.images[image.source].name << "\")" << std::endl;
+                continue;
+            }
+
+            TextureData& texture = storage->images.emplace_back(std::move(image.texture.value));
+            image_remap[i] = i32(scene.images.size());
+
+            // RGB8 is padded to 4 bytes by drivers
+            uncompressed_texture_bytes += image_byte_size(ImageFormat::RGBA8_UNORM, texture.size, Texture::mip_levels(texture.size));
+            texture_bytes += image_byte_size(texture.format, texture.size, Texture::mip_levels(texture.size));
+
+            scene.images.push_back(SceneData::Image{
+                Span<const u8>(texture.data.get(), image_byte_size(texture.format, texture.size, texture.mip_levels)),
+                texture.size,
+                texture.format,
+                texture.mip_levels
+            });
+        }
+
+        for(SceneData::Material& mat : scene.materials) {
+            mat.albedo = mat.albedo >= 0 ? image_remap[mat.albedo] : -1;
+            mat.normal = mat.normal >= 0 ? image_remap[mat.normal] : -1;
+        }
+    }
+
+    scene.storage = std::move(storage);
+
+    // What decoding every instance separately would have cost on top of this
+    size_t saved_bytes = 0;
+    double saved_time = 0.0;
+    for(size_t i = 0; i != primitives.size(); ++i) {
+        if(instance_counts[i] > 1) {
+            const SceneData::Mesh& mesh = scene.meshes[i];
+            const size_t mesh_bytes = mesh.vertices.size() + mesh.indices.size();
+            saved_bytes += (instance_counts[i] - 1) * mesh_bytes;
+            saved_time += double(instance_counts[i] - 1) * decode_times[i];
+        }
+    }
+
     std::cout << "Loaded:" << std::endl;
     std::cout << "  - " << gltf.meshes.size() << " meshes" << std::endl;
+    std::cout << "  - " << primitives.size() << " unique primitives for " << instances.size() << " instances" << std::endl;
+    std::cout << "  - " << std::round(double(saved_bytes) / (1024.0 * 1024.0) * 100.0) / 100.0 << "MB of VRAM and "
+              << std::round(saved_time * 1000.0 * 100.0) / 100.0 << "ms of decoding saved by sharing primitives" << std::endl;
+    std::cout << "  - " << std::round(double(vertex_bytes) / (1024.0 * 1024.0) * 100.0) / 100.0 << "MB of vertices";
+    if(vertex_bytes != float_vertex_bytes) {
+        std::cout << " (" << std::round(double(float_vertex_bytes - vertex_bytes) / (1024.0 * 1024.0) * 100.0) / 100.0 << "MB saved by "
+                  << (settings.compact_vertices ? "compact" : "quantized") << " vertices)";
+    }
+    std::cout << std::endl;
+    std::cout << "  - " << std::round(double(index_bytes) / (1024.0 * 1024.0) * 100.0) / 100.0 << "MB of indices ("
+              << std::round(double(u32_index_bytes - index_bytes) / (1024.0 * 1024.0) * 100.0) / 100.0 << "MB saved by 16 bit indices)" << std::endl;
+    if(settings.build_meshlets) {
+        std::cout << "  - " << meshlet_count << " meshlets" << std::endl;
+    }
+    if(!lod_triangles.empty()) {
+        std::cout << "  - " << lod_triangles.size() << " LODs (triangles:";
+        for(const size_t triangles : lod_triangles) {
+            std::cout << " " << triangles;
+        }
+        std::cout << ")" << std::endl;
+    }
     std::cout << "  - " << gltf.materials.size() << " materials" << std::endl;
-    std::cout << "  - " << scene->get_point_light_count() << " point lights" << std::endl;
+    std::cout << "  - " << scene.images.size() << " textures using " << std::round(double(texture_bytes) / (1024.0 * 1024.0) * 100.0) / 100.0 << "MB of VRAM ("
+              << std::round(double(uncompressed_texture_bytes - texture_bytes) / (1024.0 * 1024.0) * 100.0) / 100.0 << "MB saved by compression)" << std::endl;
+    std::cout << "  - " << scene.point_lights.size() << " point lights" << std::endl;
+
+    if(settings.optimize_meshes && !decoded.empty()) {
+        auto round2 = [](float x) { return std::round(x * 100.0f) / 100.0f; };
+
+        std::cout << "Vertex cache (ACMR, ATVR before -> after):" << std::endl;
+        for(size_t i = 0; i != decoded.size(); ++i) {
+            const DecodedPrimitive& mesh = decoded[i];
+            std::cout << "  - " << (primitive_names[i].empty() ? "mesh " + std::to_string(i) : "\"" + primitive_names[i] + "\"")
+                      << " (" << (mesh.lods.empty() ? mesh.data.value.indices.size() : mesh.lods[0].index_count) / 3 << " triangles): "
+                      << round2(mesh.cache_stats_before.acmr) << ", " << round2(mesh.cache_stats_before.atvr) << " -> "
+                      << round2(mesh.cache_stats_after.acmr) << ", " << round2(mesh.cache_stats_after.atvr) << std::endl;
+        }
+    }
+
+    if(!image_imports.empty()) {
+        auto total_time = [](const ImageImport& image) { return image.decode_time + image.mips_time + image.compression_time; };
+
+        std::vector<size_t> slowest_images(image_imports.size());
+        std::iota(slowest_images.begin(), slowest_images.end(), size_t(0));
+        std::sort(slowest_images.begin(), slowest_images.end(), [&](size_t a, size_t b) { return total_time(image_imports[a]) > total_time(image_imports[b]); });
+
+        auto ms = [](double t) { return std::round(t * 1000.0 * 100.0) / 100.0; };
+
+        std::cout << "Image import times (decode + mips + compression):" << std::endl;
+        for(const size_t i : slowest_images) {
+            const ImageImport& import = image_imports[i];
+            const tinygltf::Image& image = gltf.images[import.source];
+            const std::string& name = image.name.empty() ? image.uri : image.name;
+            std::cout << "  - " << (name.empty() ? "image " + std::to_string(import.source) : "\"" + name + "\"")
+                      << ": " << ms(total_time(import)) << "ms (" << ms(import.decode_time) << " + " << ms(import.mips_time) << " + " << ms(import.compression_time) << ")" << std::endl;
+        }
+    }
 
     return {true, std::move(scene)};
 }
 
+// External buffers and images are part of the scene: their paths, sizes and modification times are hashed with the source
+static u64 hash_external_files(const std::string& file_name, Span<const u8> source, u64 seed) {
+    const Span<const u8> json_bytes = gltf_json(source, ends_with(file_name, ".gltf"));
+    const std::string_view json_text(reinterpret_cast<const char*>(json_bytes.data()), json_bytes.size());
+    if(json_text.find("\"uri\"") == std::string_view::npos) {
+        return seed;
+    }
+
+    const nlohmann::json json = nlohmann::json::parse(json_text.begin(), json_text.end(), nullptr, false);
+    if(!json.is_object()) {
+        return seed;
+    }
+
+    const std::filesystem::path base_dir = std::filesystem::path(file_name).parent_path();
+    u64 hash = seed;
+    for(const char* array : {"buffers", "images"}) {
+        const auto entries = json.find(array);
+        if(entries == json.end() || !entries->is_array()) {
+            continue;
+        }
+
+        for(const nlohmann::json& entry : *entries) {
+            const auto uri = entry.find("uri");
+            if(uri == entry.end() || !uri->is_string()) {
+                continue;
+            }
+
+            // Data URIs are in the source itself
+            const std::string& path = uri->get_ref<const std::string&>();
+            if(path.rfind("data:", 0) == 0) {
+                continue;
+            }
+
+            // Missing files hash as an error size and time, so that they change the key too
+            std::error_code error;
+            const std::filesystem::path file = base_dir / tinygltf::dlib::urldecode(path);
+            const u64 size = u64(std::filesystem::file_size(file, error));
+            const i64 time = i64(std::filesystem::last_write_time(file, error).time_since_epoch().count());
+
+            hash = hash_bytes(path.data(), path.size(), hash);
+            hash = hash_bytes(&size, sizeof(size), hash);
+            hash = hash_bytes(&time, sizeof(time), hash);
+        }
+    }
+    return hash;
+}
+
+Result<SceneData> SceneData::from_gltf(const std::string& file_name, const SceneImportSettings& settings) {
+    auto source = MappedFile::map(file_name);
+    if(!source.is_ok) {
+        std::cerr << "Unable to open \"" << file_name << "\"" << std::endl;
+        return {false, {}};
+    }
+
+    // The baked scene is only used if it was built from this exact source and external files,
+    // with the same settings and format version
+    const u64 cache_key = hash_external_files(file_name, source.value.bytes(), hash_bytes(source.value.data(), source.value.size(), settings.hash()));
+    const std::string baked_name = baked_file_name(file_name);
+
+    if(auto baked = from_baked(baked_name, cache_key); baked.is_ok) {
+        std::cout << file_name << " loaded from \"" << baked_name << "\"" << std::endl;
+        return baked;
+    }
+
+    auto scene = import_gltf(file_name, source.value.bytes(), settings);
+    if(scene.is_ok) {
+        const double bake_start = program_time();
+        if(scene.value.bake(baked_name, cache_key).is_ok) {
+            std::cout << file_name << " baked to \"" << baked_name << "\" in " << std::round((program_time() - bake_start) * 100.0) / 100.0 << "s" << std::endl;
+        } else {
+            std::cerr << "Unable to bake scene to \"" << baked_name << "\"" << std::endl;
+        }
+    }
+    return scene;
+}
+
+Result<std::unique_ptr<Scene>> Scene::from_gltf(const std::string& file_name, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines, const SceneImportSettings& settings) {
+    const double time = program_time();
+    DEFER(std::cout << file_name << " loaded in " << std::round((program_time() - time) * 1000.0 * 100.0) / 100.0 << "ms" << std::endl);
+
+    const auto data = SceneData::from_gltf(file_name, settings);
+    if(!data.is_ok) {
+        return {false, {}};
+    }
+
+    return {true, from_data(data.value, pipeline, defines)};
+}
+
+std::unique_ptr<AsyncSceneLoader> Scene::from_gltf_async(const std::string& file_name, const std::pair<const char *, const char *> pipeline, Span<const std::string> defines, const SceneImportSettings& settings) {
+    return std::make_unique<AsyncSceneLoader>(file_name, pipeline, defines, settings);
+}
+
 }
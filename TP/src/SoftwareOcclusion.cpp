@@ -0,0 +1,490 @@
+#include "SoftwareOcclusion.h"
+
+#include <JobSystem.h>
+#include <Camera.h>
+#include <Material.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OM3D_OCCLUSION_SSE
+#include <immintrin.h>
+
+// The AVX2 kernel is compiled for it regardless of the build flags, and only called if the CPU has it
+#if defined(__GNUC__) || defined(__clang__)
+#define OM3D_OCCLUSION_AVX
+#define OM3D_OCCLUSION_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER)
+#define OM3D_OCCLUSION_AVX
+#define OM3D_OCCLUSION_TARGET(isa)
+#endif
+#endif
+
+namespace OM3D {
+
+static constexpr u32 tiles_x = OcclusionBuffer::width / OcclusionBuffer::tile_width;
+static constexpr u32 tiles_y = OcclusionBuffer::height / OcclusionBuffer::tile_height;
+
+static_assert(OcclusionBuffer::width % OcclusionBuffer::tile_width == 0 && OcclusionBuffer::height % OcclusionBuffer::tile_height == 0);
+// Kernels write whole groups of 8 pixels, which must not cross tiles
+static_assert(OcclusionBuffer::tile_width % 8 == 0);
+
+size_t OccluderMesh::triangle_count() const {
+    return indices.size() / 3;
+}
+
+OcclusionBuffer::OcclusionBuffer() :
+    _depth(size_t(width) * height, 0.0f),
+    _tile_farthest(tiles_x * tiles_y, 0.0f) {
+}
+
+void OcclusionBuffer::begin(const glm::mat4& view_proj) {
+    _view_proj = view_proj;
+    _occluders.clear();
+    _triangle_count = 0;
+}
+
+// Returns false if the point is behind the camera or in front of the near plane
+static bool project(const glm::vec4& clip, glm::vec3& screen) {
+    if(clip.w <= 0.0f || clip.z > clip.w) {
+        return false;
+    }
+    const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    screen = glm::vec3((ndc.x * 0.5f + 0.5f) * float(OcclusionBuffer::width), (ndc.y * 0.5f + 0.5f) * float(OcclusionBuffer::height), ndc.z);
+    return true;
+}
+
+void OcclusionBuffer::add_occluder(const OccluderMesh& mesh, const glm::mat4& transform, bool double_sided) {
+    Occluder occluder;
+    occluder.mesh = &mesh;
+    occluder.mvp = _view_proj * transform;
+    // Mirroring transforms flip the winding
+    occluder.mirrored = glm::determinant(glm::mat3(transform)) < 0.0f;
+    occluder.double_sided = double_sided;
+    _occluders.push_back(occluder);
+}
+
+// Triangles [begin, end) of all the occluders, `first_triangles` being the index of the first triangle of each occluder
+void OcclusionBuffer::project_triangles(Span<const size_t> first_triangles, size_t begin, size_t end, TriangleChunk& chunk) const {
+    size_t o = size_t(std::upper_bound(first_triangles.begin(), first_triangles.end(), begin) - first_triangles.begin()) - 1;
+    for(size_t t = begin; t != end; ++t) {
+        while(t >= first_triangles[o + 1]) {
+            ++o;
+        }
+        const Occluder& occluder = _occluders[o];
+        const OccluderMesh& mesh = *occluder.mesh;
+        const size_t i = (t - first_triangles[o]) * 3;
+
+        glm::vec3 v[3];
+        bool in_front = true;
+        for(u32 k = 0; k != 3; ++k) {
+            in_front &= project(occluder.mvp * glm::vec4(mesh.positions[mesh.indices[i + k]], 1.0f), v[k]);
+        }
+        if(!in_front) {
+            continue;
+        }
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        const bool front_facing = (area > 0.0f) != occluder.mirrored;
+        if(std::abs(area) < 1e-6f || (!front_facing && !occluder.double_sided)) {
+            continue;
+        }
+
+        // Edge functions are positive inside counter clockwise triangles
+        if(area < 0.0f) {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        const float min_x = std::min({v[0].x, v[1].x, v[2].x});
+        const float max_x = std::max({v[0].x, v[1].x, v[2].x});
+        const float min_y = std::min({v[0].y, v[1].y, v[2].y});
+        const float max_y = std::max({v[0].y, v[1].y, v[2].y});
+        if(max_x < 0.0f || max_y < 0.0f || min_x >= float(width) || min_y >= float(height)) {
+            continue;
+        }
+
+        Triangle triangle = {};
+        for(u32 e = 0; e != 3; ++e) {
+            const glm::vec3& a = v[e];
+            const glm::vec3& b = v[(e + 1) % 3];
+            triangle.edge_a[e] = a.y - b.y;
+            triangle.edge_b[e] = b.x - a.x;
+            triangle.edge_c[e] = -(triangle.edge_a[e] * a.x + triangle.edge_b[e] * a.y);
+        }
+
+        triangle.z_a = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+        triangle.z_b = ((v[1].x - v[0].x) * (v[2].z - v[0].z) - (v[2].x - v[0].x) * (v[1].z - v[0].z)) / area;
+        triangle.z_c = v[0].z - triangle.z_a * v[0].x - triangle.z_b * v[0].y;
+
+        triangle.min_x = u32(std::max(min_x, 0.0f));
+        triangle.min_y = u32(std::max(min_y, 0.0f));
+        triangle.max_x = u32(std::min(max_x, float(width - 1)));
+        triangle.max_y = u32(std::min(max_y, float(height - 1)));
+
+        const u32 index = u32(chunk.triangles.size());
+        chunk.triangles.push_back(triangle);
+        for(u32 ty = triangle.min_y / tile_height; ty <= triangle.max_y / tile_height; ++ty) {
+            for(u32 tx = triangle.min_x / tile_width; tx <= triangle.max_x / tile_width; ++tx) {
+                chunk.tile_triangles[ty * tiles_x + tx].push_back(index);
+            }
+        }
+    }
+}
+
+// Kernels rasterize the pixels of a triangle in [x_begin, x_end) x [y_begin, y_end), x_begin being a multiple of 8.
+// Edge functions and depth are evaluated the same way by all of them, so that they write the exact same depth
+struct RasterRect {
+    u32 x_begin;
+    u32 x_end;
+    u32 y_begin;
+    u32 y_end;
+};
+
+static void rasterize_scalar(const OcclusionBuffer::Triangle& triangle, const RasterRect& rect, float* depth) {
+    for(u32 y = rect.y_begin; y != rect.y_end; ++y) {
+        const float center_y = float(y) + 0.5f;
+        const float row_edge[3] = {
+            triangle.edge_b[0] * center_y + triangle.edge_c[0],
+            triangle.edge_b[1] * center_y + triangle.edge_c[1],
+            triangle.edge_b[2] * center_y + triangle.edge_c[2],
+        };
+        const float row_z = triangle.z_b * center_y + triangle.z_c;
+
+        float* row = depth + y * OcclusionBuffer::width;
+        for(u32 x = rect.x_begin; x < rect.x_end; ++x) {
+            const float center_x = float(x) + 0.5f;
+            const bool inside = triangle.edge_a[0] * center_x + row_edge[0] >= 0.0f && triangle.edge_a[1] * center_x + row_edge[1] >= 0.0f && triangle.edge_a[2] * center_x + row_edge[2] >= 0.0f;
+            if(inside) {
+                row[x] = std::max(row[x], triangle.z_a * center_x + row_z);
+            }
+        }
+    }
+}
+
+#ifdef OM3D_OCCLUSION_SSE
+static void rasterize_sse2(const OcclusionBuffer::Triangle& triangle, const RasterRect& rect, float* depth) {
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 edge_a_0 = _mm_set1_ps(triangle.edge_a[0]);
+    const __m128 edge_a_1 = _mm_set1_ps(triangle.edge_a[1]);
+    const __m128 edge_a_2 = _mm_set1_ps(triangle.edge_a[2]);
+    const __m128 z_a = _mm_set1_ps(triangle.z_a);
+
+    for(u32 y = rect.y_begin; y != rect.y_end; ++y) {
+        const float center_y = float(y) + 0.5f;
+        const __m128 row_edge_0 = _mm_set1_ps(triangle.edge_b[0] * center_y + triangle.edge_c[0]);
+        const __m128 row_edge_1 = _mm_set1_ps(triangle.edge_b[1] * center_y + triangle.edge_c[1]);
+        const __m128 row_edge_2 = _mm_set1_ps(triangle.edge_b[2] * center_y + triangle.edge_c[2]);
+        const __m128 row_z = _mm_set1_ps(triangle.z_b * center_y + triangle.z_c);
+
+        float* row = depth + y * OcclusionBuffer::width;
+        for(u32 x = rect.x_begin; x < rect.x_end; x += 4) {
+            const __m128 center_x = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a_0, center_x), row_edge_0), zero);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a_1, center_x), row_edge_1), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a_2, center_x), row_edge_2), zero));
+
+            const __m128 z = _mm_add_ps(_mm_mul_ps(z_a, center_x), row_z);
+            const __m128 previous = _mm_loadu_ps(row + x);
+            const __m128 nearest = _mm_max_ps(previous, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+        }
+    }
+}
+#endif
+
+#ifdef OM3D_OCCLUSION_AVX
+OM3D_OCCLUSION_TARGET("avx2")
+static void rasterize_avx2(const OcclusionBuffer::Triangle& triangle, const RasterRect& rect, float* depth) {
+    const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 edge_a_0 = _mm256_set1_ps(triangle.edge_a[0]);
+    const __m256 edge_a_1 = _mm256_set1_ps(triangle.edge_a[1]);
+    const __m256 edge_a_2 = _mm256_set1_ps(triangle.edge_a[2]);
+    const __m256 z_a = _mm256_set1_ps(triangle.z_a);
+
+    for(u32 y = rect.y_begin; y != rect.y_end; ++y) {
+        const float center_y = float(y) + 0.5f;
+        const __m256 row_edge_0 = _mm256_set1_ps(triangle.edge_b[0] * center_y + triangle.edge_c[0]);
+        const __m256 row_edge_1 = _mm256_set1_ps(triangle.edge_b[1] * center_y + triangle.edge_c[1]);
+        const __m256 row_edge_2 = _mm256_set1_ps(triangle.edge_b[2] * center_y + triangle.edge_c[2]);
+        const __m256 row_z = _mm256_set1_ps(triangle.z_b * center_y + triangle.z_c);
+
+        float* row = depth + y * OcclusionBuffer::width;
+        for(u32 x = rect.x_begin; x < rect.x_end; x += 8) {
+            const __m256 center_x = _mm256_add_ps(_mm256_set1_ps(float(x)), offsets);
+            __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_a_0, center_x), row_edge_0), zero, _CMP_GE_OQ);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_a_1, center_x), row_edge_1), zero, _CMP_GE_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_a_2, center_x), row_edge_2), zero, _CMP_GE_OQ));
+
+            const __m256 z = _mm256_add_ps(_mm256_mul_ps(z_a, center_x), row_z);
+            const __m256 previous = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(previous, _mm256_max_ps(previous, z), inside));
+        }
+    }
+}
+#endif
+
+using RasterizeFunc = void (*)(const OcclusionBuffer::Triangle&, const RasterRect&, float*);
+
+static RasterizeFunc rasterize_func(SimdLevel level) {
+    switch(std::min(level, best_simd_level())) {
+#ifdef OM3D_OCCLUSION_AVX
+        case SimdLevel::AVX512:
+        case SimdLevel::AVX2:
+            return rasterize_avx2;
+#endif
+
+#ifdef OM3D_OCCLUSION_SSE
+        case SimdLevel::SSE2:
+            return rasterize_sse2;
+#endif
+
+        default:
+            return rasterize_scalar;
+    }
+}
+
+// Triangles per projection job, each one is a few dozen nanoseconds
+static constexpr size_t triangle_grain = 512;
+
+void OcclusionBuffer::rasterize(SimdLevel level) {
+    std::vector<size_t> first_triangles;
+    first_triangles.reserve(_occluders.size() + 1);
+    size_t triangles = 0;
+    for(const Occluder& occluder : _occluders) {
+        first_triangles.push_back(triangles);
+        triangles += occluder.mesh->triangle_count();
+    }
+    first_triangles.push_back(triangles);
+
+    _chunks.resize(std::max(_chunks.size(), chunk_count(triangles, triangle_grain)));
+    for(TriangleChunk& chunk : _chunks) {
+        chunk.triangles.clear();
+        chunk.tile_triangles.resize(tiles_x * tiles_y);
+        for(std::vector<u32>& tile_triangles : chunk.tile_triangles) {
+            tile_triangles.clear();
+        }
+    }
+    parallel_for_chunks(triangles, triangle_grain, [&](size_t chunk, size_t begin, size_t end) {
+        project_triangles(first_triangles, begin, end, _chunks[chunk]);
+    });
+
+    _triangle_count = 0;
+    for(const TriangleChunk& chunk : _chunks) {
+        _triangle_count += chunk.triangles.size();
+    }
+
+    parallel_for(tiles_x * tiles_y, [&](size_t tile) {
+        rasterize_tile(u32(tile), level);
+    });
+}
+
+void OcclusionBuffer::rasterize_tile(u32 tile, SimdLevel level) {
+    const RasterizeFunc rasterize_triangle = rasterize_func(level);
+
+    const u32 tile_x = (tile % tiles_x) * tile_width;
+    const u32 tile_y = (tile / tiles_x) * tile_height;
+
+    for(u32 y = tile_y; y != tile_y + tile_height; ++y) {
+        std::fill_n(_depth.data() + y * width + tile_x, tile_width, 0.0f);
+    }
+
+    for(const TriangleChunk& chunk : _chunks) {
+        for(const u32 index : chunk.tile_triangles[tile]) {
+            const Triangle& triangle = chunk.triangles[index];
+
+            // Groups of 8 pixels, outside pixels are rejected by the edge functions
+            RasterRect rect = {};
+            rect.x_begin = std::max(triangle.min_x, tile_x) & ~7u;
+            rect.x_end = std::min(triangle.max_x + 1, tile_x + tile_width);
+            rect.y_begin = std::max(triangle.min_y, tile_y);
+            rect.y_end = std::min(triangle.max_y + 1, tile_y + tile_height);
+            rasterize_triangle(triangle, rect, _depth.data());
+        }
+    }
+
+    float farthest = 1.0f;
+    for(u32 y = tile_y; y != tile_y + tile_height; ++y) {
+        const float* row = _depth.data() + y * width + tile_x;
+        farthest = std::min(farthest, *std::min_element(row, row + tile_width));
+    }
+    _tile_farthest[tile] = farthest;
+}
+
+bool OcclusionBuffer::is_occluded(const CenteredBox& box) const {
+    glm::vec2 min_screen(FLT_MAX);
+    glm::vec2 max_screen(-FLT_MAX);
+    float nearest = 0.0f;
+    for(u32 i = 0; i != 8; ++i) {
+        const glm::vec3 corner_sign((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+        glm::vec3 screen;
+        if(!project(_view_proj * glm::vec4(box.center + box.extents * corner_sign, 1.0f), screen)) {
+            return false;
+        }
+        min_screen = glm::min(min_screen, glm::vec2(screen));
+        max_screen = glm::max(max_screen, glm::vec2(screen));
+        nearest = std::max(nearest, screen.z);
+    }
+
+    // Outside of the buffer is outside of the frustum, which isn't for this test to decide
+    if(max_screen.x < 0.0f || max_screen.y < 0.0f || min_screen.x >= float(width) || min_screen.y >= float(height)) {
+        return false;
+    }
+
+    const u32 x_begin = u32(std::max(min_screen.x, 0.0f));
+    const u32 y_begin = u32(std::max(min_screen.y, 0.0f));
+    const u32 x_last = u32(std::min(max_screen.x, float(width - 1)));
+    const u32 y_last = u32(std::min(max_screen.y, float(height - 1)));
+
+    // Whole tiles first, which settles most of the occluded boxes
+    bool tiles_occlude = true;
+    for(u32 ty = y_begin / tile_height; ty <= y_last / tile_height && tiles_occlude; ++ty) {
+        for(u32 tx = x_begin / tile_width; tx <= x_last / tile_width && tiles_occlude; ++tx) {
+            tiles_occlude = _tile_farthest[ty * tiles_x + tx] > nearest;
+        }
+    }
+    if(tiles_occlude) {
+        return true;
+    }
+
+    for(u32 y = y_begin; y <= y_last; ++y) {
+        const float* row = _depth.data() + y * width;
+        for(u32 x = x_begin; x <= x_last; ++x) {
+            if(row[x] <= nearest) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t OcclusionBuffer::triangle_count() const {
+    return _triangle_count;
+}
+
+Span<const float> OcclusionBuffer::depth() const {
+    return _depth;
+}
+
+bool can_occlude(const Material& material) {
+    return material.is_opaque();
+}
+
+// Square facing +Z (counter clockwise seen from the camera below)
+static OccluderMesh square_occluder(float half_size, float z) {
+    OccluderMesh mesh;
+    mesh.positions = {
+        glm::vec3(-half_size, -half_size, z),
+        glm::vec3(half_size, -half_size, z),
+        glm::vec3(half_size, half_size, z),
+        glm::vec3(-half_size, half_size, z),
+    };
+    mesh.indices = {0, 1, 2, 0, 2, 3};
+    return mesh;
+}
+
+bool occlusion_self_check() {
+    bool ok = true;
+    const auto check = [&](bool cond, const std::string& what) {
+        std::cout << (cond ? "  ok: " : "  FAILED: ") << what << std::endl;
+        ok &= cond;
+    };
+
+    // Camera at the origin looking down -Z
+    Camera camera;
+    camera.set_view(glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    const OccluderMesh wall = square_occluder(10.0f, -10.0f);
+    OccluderMesh back_facing_wall = wall;
+    std::reverse(back_facing_wall.indices.begin(), back_facing_wall.indices.end());
+
+    const CenteredBox hidden = {glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f)};
+    const CenteredBox in_front = {glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(1.0f)};
+    const CenteredBox sticking_out = {glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(30.0f, 1.0f, 1.0f)};
+    const CenteredBox around_camera = {glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f, 1.0f, 30.0f)};
+
+    OcclusionBuffer buffer;
+    std::vector<float> reference;
+    for(SimdLevel level = SimdLevel::Scalar; level <= best_simd_level(); level = SimdLevel(u32(level) + 1)) {
+        const std::string name = simd_level_name(level);
+
+        buffer.begin(camera.view_proj_matrix());
+        buffer.add_occluder(wall, glm::mat4(1.0f), false);
+        buffer.rasterize(level);
+        check(buffer.is_occluded(hidden), name + ": box behind the wall is occluded");
+        check(!buffer.is_occluded(in_front), name + ": box in front of the wall is visible");
+        check(!buffer.is_occluded(sticking_out), name + ": box larger than the wall is visible");
+        check(!buffer.is_occluded(around_camera), name + ": box crossing the near plane is visible");
+
+        if(level == SimdLevel::Scalar) {
+            reference.assign(buffer.depth().begin(), buffer.depth().end());
+        } else {
+            bool same = true;
+            for(size_t i = 0; i != reference.size(); ++i) {
+                same &= std::abs(reference[i] - buffer.depth().data()[i]) <= 1e-6f;
+            }
+            check(same, name + ": depth matches the scalar rasterizer");
+        }
+
+        buffer.begin(camera.view_proj_matrix());
+        buffer.add_occluder(back_facing_wall, glm::mat4(1.0f), false);
+        buffer.rasterize(level);
+        check(!buffer.is_occluded(hidden), name + ": back facing wall doesn't occlude");
+
+        buffer.begin(camera.view_proj_matrix());
+        buffer.add_occluder(back_facing_wall, glm::mat4(1.0f), true);
+        buffer.rasterize(level);
+        check(buffer.is_occluded(hidden), name + ": double sided back facing wall occludes");
+    }
+
+    // Same selection as Scene::cull_occluded
+    for(const BlendMode blend_mode : {BlendMode::None, BlendMode::Alpha, BlendMode::Additive}) {
+        Material material;
+        material.set_blend_mode(blend_mode);
+
+        buffer.begin(camera.view_proj_matrix());
+        if(can_occlude(material)) {
+            buffer.add_occluder(wall, glm::mat4(1.0f), !material.culls_back_faces());
+        }
+        buffer.rasterize();
+        const bool opaque = blend_mode == BlendMode::None;
+        check(buffer.is_occluded(hidden) == opaque, opaque ? "opaque wall occludes" : "blended wall doesn't occlude");
+    }
+
+    // Random triangles a few units wide in front of the camera, as many as a frame's occluders add up to
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> random(-1.0f, 1.0f);
+    OccluderMesh soup;
+    for(size_t i = 0; i != OcclusionBuffer::triangle_budget; ++i) {
+        const float z = -5.0f - 45.0f * (random(rng) * 0.5f + 0.5f);
+        const glm::vec3 center(random(rng) * -z, random(rng) * -z * 0.6f, z);
+        for(u32 k = 0; k != 3; ++k) {
+            soup.positions.push_back(center + glm::vec3(random(rng), random(rng), random(rng)) * 2.0f);
+            soup.indices.push_back(u32(soup.indices.size()));
+        }
+    }
+
+    // Averaged over a few frames, the first one allocates the bins
+    constexpr u32 frames = 16;
+    double time = 0.0;
+    for(u32 i = 0; i != frames + 1; ++i) {
+        const double start = program_time();
+        buffer.begin(camera.view_proj_matrix());
+        buffer.add_occluder(soup, glm::mat4(1.0f), true);
+        buffer.rasterize();
+        time += i ? program_time() - start : 0.0;
+    }
+    std::cout << "  " << buffer.triangle_count() << " triangles projected and rasterized in " << time / frames * 1000.0 << "ms ("
+              << simd_level_name(best_simd_level()) << ", " << job_thread_count() << " threads)" << std::endl;
+
+    std::cout << (ok ? "Occlusion self check passed" : "Occlusion self check FAILED") << std::endl;
+    return ok;
+}
+
+}
@@ -0,0 +1,108 @@
+#ifndef SOFTWAREOCCLUSION_H
+#define SOFTWAREOCCLUSION_H
+
+#include <Bounds.h>
+#include <FrustumCulling.h>
+
+#include <glm/matrix.hpp>
+
+#include <vector>
+
+namespace OM3D {
+
+class Material;
+
+// Object space triangles drawn into the occlusion buffer in place of a mesh, usually its coarsest LOD
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<u32> indices;
+
+    size_t triangle_count() const;
+};
+
+// Low resolution reverse-Z depth buffer rasterized on the CPU from a few occluders, so that hidden objects can be
+// rejected without reading anything back from the GPU. The buffer is split into tiles that are rasterized in parallel
+class OcclusionBuffer : NonCopyable {
+
+    public:
+        static constexpr u32 width = 256;
+        static constexpr u32 height = 144;
+        static constexpr u32 tile_width = 32;
+        static constexpr u32 tile_height = 16;
+        // Occluder triangles drawn per frame, about 1.8ms of projection and rasterization on a single thread
+        static constexpr size_t triangle_budget = 4096;
+
+        OcclusionBuffer();
+
+        // Clears the depth, occluders and tests until the next call use `view_proj`
+        void begin(const glm::mat4& view_proj);
+
+        // Queues the mesh, which must outlive the next rasterize(). Triangles crossing the near plane are skipped,
+        // as well as back facing ones unless `double_sided` (for materials that don't cull back faces)
+        void add_occluder(const OccluderMesh& mesh, const glm::mat4& transform, bool double_sided);
+
+        // Projects and bins the queued triangles in parallel chunks, then rasterizes them one job per tile.
+        // `level` above best_simd_level() falls back to the best one
+        void rasterize(SimdLevel level = best_simd_level());
+
+        // True if the box is entirely behind the rasterized occluders. Boxes crossing the near plane are never occluded
+        bool is_occluded(const CenteredBox& box) const;
+
+        size_t triangle_count() const;
+        // Rows from the bottom of the screen, 0 where nothing was rasterized
+        Span<const float> depth() const;
+
+        // Screen space triangle: inside where every edge function e(x, y) = a * x + b * y + c is positive,
+        // with depth z(x, y) = z_a * x + z_b * y + z_c. Both are evaluated at pixel centers
+        struct Triangle {
+            float edge_a[3];
+            float edge_b[3];
+            float edge_c[3];
+            float z_a;
+            float z_b;
+            float z_c;
+            u32 min_x;
+            u32 min_y;
+            u32 max_x;
+            u32 max_y;
+        };
+
+    private:
+        struct Occluder {
+            const OccluderMesh* mesh = nullptr;
+            glm::mat4 mvp;
+            bool mirrored = false;
+            bool double_sided = false;
+        };
+
+        // Triangles projected by one job, and their indices binned per tile
+        struct TriangleChunk {
+            std::vector<Triangle> triangles;
+            std::vector<std::vector<u32>> tile_triangles;
+        };
+
+        void project_triangles(Span<const size_t> first_triangles, size_t begin, size_t end, TriangleChunk& chunk) const;
+        void rasterize_tile(u32 tile, SimdLevel level);
+
+        glm::mat4 _view_proj = glm::mat4(1.0f);
+        std::vector<float> _depth;
+
+        std::vector<Occluder> _occluders;
+        // Kept between frames so that the bins keep their memory
+        std::vector<TriangleChunk> _chunks;
+        size_t _triangle_count = 0;
+        // Farthest depth of each tile, occludes whatever is behind it in the whole tile
+        std::vector<float> _tile_farthest;
+};
+
+// Blended objects let what's behind them show through, only opaque ones are drawn as occluders.
+// Occluders are double sided if their material doesn't cull back faces
+bool can_occlude(const Material& material);
+
+// Checks the rasterizer and the occlusion tests against known scenes, and times a few thousand triangles.
+// Doesn't need a GPU, run with --occlusion-self-check
+bool occlusion_self_check();
+
+}
+
+#endif // SOFTWAREOCCLUSION_H
@@ -1,31 +1,164 @@
 #include "StaticMesh.h"
 
+#include <FrameAllocator.h>
+
 #include <glad/glad.h>
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
 #include <glm/glm.hpp>
 
 namespace OM3D {
 
-StaticMesh::StaticMesh(const MeshData& data) :
-    _vertex_buffer(data.vertices),
-    _index_buffer(data.indices),
-    hash(CollectionHasher<std::vector<Vertex>>()(data.vertices) ^ CollectionHasher<std::vector<u32>>()(data.indices)) {
+size_t MeshData::hash() const {
+    return CollectionHasher<std::vector<Vertex>>()(vertices) ^ CollectionHasher<std::vector<u32>>()(indices);
+}
 
-    glm::vec3 center = glm::vec3(0.0f);
-    
-    const auto cmp = [center](const Vertex v1, const Vertex v2) {
-        return glm::length(v1.position - center) < glm::length(v2.position - center);
-    };
-    const auto v = *std::max_element(data.vertices.begin(), data.vertices.end(), cmp);
+MeshBounds MeshData::bounds() const {
+    return compute_mesh_bounds(vertices);
+}
+
+StaticMesh::StaticMesh(const MeshData& data) : StaticMesh(data, data.hash(), data.bounds()) {
+}
+
+// Follows GL's conversion of normalized integers
+static float decode_component(ComponentType type, bool normalized, const u8* data) {
+    switch(type) {
+        case ComponentType::Byte: {
+            i8 value = 0;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? std::max(float(value) / 127.0f, -1.0f) : float(value);
+        }
+
+        case ComponentType::UnsignedByte: {
+            u8 value = 0;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? float(value) / 255.0f : float(value);
+        }
+
+        case ComponentType::Short: {
+            i16 value = 0;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? std::max(float(value) / 32767.0f, -1.0f) : float(value);
+        }
+
+        case ComponentType::UnsignedShort: {
+            u16 value = 0;
+            std::memcpy(&value, data, sizeof(value));
+            return normalized ? float(value) / 65535.0f : float(value);
+        }
 
-    radius = glm::length(v.position - center);
+        case ComponentType::Float: {
+            float value = 0.0f;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+    }
+    return 0.0f;
+}
+
+// Object space position, as computed by basic.vert for each vertex format
+static glm::vec3 decode_position(VertexFormat format, const u8* vertex, const PositionDequantization& dequantization, const QuantizedLayout& quantized_layout) {
+    switch(format) {
+        case VertexFormat::Float: {
+            glm::vec3 position;
+            std::memcpy(&position, vertex + offsetof(Vertex, position), sizeof(position));
+            return position;
+        }
+
+        case VertexFormat::Compact:
+        case VertexFormat::CompactColor: {
+            u16 quantized[3] = {};
+            std::memcpy(quantized, vertex + offsetof(CompactVertex, position), sizeof(quantized));
+            return dequantization.offset + glm::vec3(quantized[0], quantized[1], quantized[2]) / 65535.0f * dequantization.scale;
+        }
+
+        case VertexFormat::Quantized: {
+            const QuantizedAttrib& attrib = quantized_layout.attribs[0];
+            glm::vec3 position(0.0f);
+            for(u32 i = 0; i != std::min(u32(attrib.components), 3u); ++i) {
+                position[i] = decode_component(attrib.type, attrib.normalized, vertex + attrib.offset + i * component_size(attrib.type));
+            }
+            return position;
+        }
+    }
+    return glm::vec3(0.0f);
+}
+
+// Only keeps the vertices referenced by the indices, which are all in [first_vertex, first_vertex + vertex count)
+static OccluderMesh build_occluder(VertexFormat format, Span<const u8> vertices, u32 first_vertex, const PositionDequantization& dequantization, const QuantizedLayout& quantized_layout, Span<const u32> indices) {
+    const size_t stride = format == VertexFormat::Quantized ? quantized_layout.stride : vertex_size(format);
+
+    OccluderMesh occluder;
+    occluder.indices.reserve(indices.size());
+
+    constexpr u32 unused = u32(-1);
+    std::vector<u32> remap(vertices.size() / stride, unused);
+    for(const u32 index : indices) {
+        const u32 local = index - first_vertex;
+        DEBUG_ASSERT(local < remap.size());
+        if(remap[local] == unused) {
+            remap[local] = u32(occluder.positions.size());
+            occluder.positions.push_back(decode_position(format, vertices.data() + local * stride, dequantization, quantized_layout));
+        }
+        occluder.indices.push_back(remap[local]);
+    }
+
+    return occluder;
+}
+
+std::vector<u16> MeshData::narrow_indices() const {
+    if(smallest_index_type(vertices.size()) != IndexType::U16) {
+        return {};
+    }
+    return std::vector<u16>(indices.begin(), indices.end());
+}
+
+StaticMesh::StaticMesh(const MeshData& data, size_t hash, const MeshBounds& bounds) : StaticMesh(data.vertices, data.indices, hash, bounds) {
+}
+
+StaticMesh::StaticMesh(Span<const Vertex> vertices, Span<const u32> indices, size_t hash, const MeshBounds& bounds) :
+    StaticMesh(VertexFormat::Float, Span<const u8>(reinterpret_cast<const u8*>(vertices.data()), vertices.size() * sizeof(Vertex)), {}, {},
+               IndexType::U32, Span<const u8>(reinterpret_cast<const u8*>(indices.data()), indices.size() * sizeof(u32)), {}, {}, hash, bounds) {
+}
+
+StaticMesh::StaticMesh(VertexFormat format, Span<const u8> vertices, const PositionDequantization& dequantization, const QuantizedLayout& quantized_layout, IndexType index_type, Span<const u8> indices, Span<const Meshlet> meshlets, Span<const MeshLod> lods, size_t hash, const MeshBounds& bounds) :
+    bounds(bounds),
+    hash(hash),
+    _vertex_buffer(vertices.data(), vertices.size()),
+    _index_buffer(indices.data(), indices.size()),
+    _index_type(index_type),
+    _index_count(indices.size() / index_size(index_type)),
+    _format(format),
+    _dequantization(dequantization),
+    _quantized_layout(quantized_layout),
+    _meshlets(meshlets.begin(), meshlets.end()),
+    _lods(lods.begin(), lods.end()) {
+    DEBUG_ASSERT(indices.size() % index_size(index_type) == 0);
+    if(_lods.empty()) {
+        _lods.push_back({0, u32(_index_count), 0.0f});
+    }
 }
 
 void StaticMesh::setup() const {
     _vertex_buffer.bind(BufferUsage::Attribute);
     _index_buffer.bind(BufferUsage::Index);
 
+    // Instance index offset, only streamed by draw_indirect
+    glDisableVertexAttribArray(7);
+    glVertexAttribI4ui(7, 0, 0, 0, 0);
+
+    if(_format == VertexFormat::Quantized) {
+        setup_quantized();
+        return;
+    }
+    if(_format != VertexFormat::Float) {
+        setup_compact();
+        return;
+    }
+
     // Vertex position
     glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex), nullptr);
     // Vertex normal
@@ -44,14 +177,169 @@ void StaticMesh::setup() const {
     glEnableVertexAttribArray(4);
 }
 
+// Matches the COMPACT_VERTEX inputs of basic.vert
+void StaticMesh::setup_compact() const {
+    const int stride = int(vertex_size(_format));
+
+    // Quantized position / bitangent sign
+    glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, true, stride, nullptr);
+    // Octahedral normal
+    glVertexAttribPointer(1, 2, GL_SHORT, true, stride, reinterpret_cast<void*>(offsetof(CompactVertex, normal)));
+    // Vertex uv
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, false, stride, reinterpret_cast<void*>(offsetof(CompactVertex, uv)));
+    // Octahedral tangent
+    glVertexAttribPointer(3, 2, GL_SHORT, true, stride, reinterpret_cast<void*>(offsetof(CompactVertex, tangent)));
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+
+    // Vertex color, constant white when the mesh has none
+    if(_format == VertexFormat::CompactColor) {
+        glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, true, stride, reinterpret_cast<void*>(sizeof(CompactVertex)));
+        glEnableVertexAttribArray(4);
+    } else {
+        glDisableVertexAttribArray(4);
+        glVertexAttrib4f(4, 1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    // Position dequantization, constant for the whole mesh
+    glVertexAttrib3f(5, _dequantization.offset.x, _dequantization.offset.y, _dequantization.offset.z);
+    glVertexAttrib3f(6, _dequantization.scale.x, _dequantization.scale.y, _dequantization.scale.z);
+}
+
+// Uses the same shader inputs as Vertex, integer attributes are converted to float by GL
+void StaticMesh::setup_quantized() const {
+    // Used for the attributes missing from the mesh
+    const glm::vec4 defaults[] = {
+        glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+        glm::vec4(0.0f),
+        glm::vec4(0.0f),
+        glm::vec4(0.0f),
+        glm::vec4(1.0f),
+    };
+
+    for(u32 i = 0; i != std::size(_quantized_layout.attribs); ++i) {
+        const QuantizedAttrib& attrib = _quantized_layout.attribs[i];
+        if(attrib.components) {
+            glVertexAttribPointer(i, attrib.components, GLenum(attrib.type), attrib.normalized, int(_quantized_layout.stride), reinterpret_cast<void*>(size_t(attrib.offset)));
+            glEnableVertexAttribArray(i);
+        } else {
+            glDisableVertexAttribArray(i);
+            glVertexAttrib4f(i, defaults[i].x, defaults[i].y, defaults[i].z, defaults[i].w);
+        }
+    }
+}
+
 void StaticMesh::draw() const {
     setup();
-    glDrawElements(GL_TRIANGLES, int(_index_buffer.element_count()), GL_UNSIGNED_INT, nullptr);
+    glDrawElements(GL_TRIANGLES, int(_lods[0].index_count), gl_index_type(), nullptr);
+}
+
+void StaticMesh::draw_instanced(size_t count, u32 lod) const {
+    DEBUG_ASSERT(lod < _lods.size());
+    setup();
+    const size_t offset = _lods[lod].first_index * index_size(_index_type);
+    glDrawElementsInstanced(GL_TRIANGLES, int(_lods[lod].index_count), gl_index_type(), reinterpret_cast<void*>(offset), int(count));
+}
+
+void StaticMesh::draw_indirect(Span<const DrawElementsIndirectCommand> commands, const TypedBuffer<u32>& instance_indices) const {
+    if(commands.is_empty()) {
+        return;
+    }
+
+    setup();
+
+    const auto command_buffer = FrameAllocator::current().allocate<DrawElementsIndirectCommand>(commands.size(), BufferUsage::DrawIndirect);
+    std::copy(commands.begin(), commands.end(), command_buffer.data());
+    command_buffer.bind(BufferUsage::DrawIndirect);
+
+    // With a divisor larger than any instance count, every instance of a command reads the element at base_instance
+    instance_indices.bind(BufferUsage::Attribute);
+    glVertexAttribIPointer(7, 1, GL_UNSIGNED_INT, sizeof(u32), nullptr);
+    glVertexAttribDivisor(7, std::numeric_limits<u32>::max());
+    glEnableVertexAttribArray(7);
+
+    glMultiDrawElementsIndirect(GL_TRIANGLES, gl_index_type(), reinterpret_cast<void*>(command_buffer.byte_offset()), int(commands.size()), 0);
+
+    glDisableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 0);
 }
 
-void StaticMesh::draw_instanced(size_t count) const {
+void StaticMesh::draw_indirect(const TypedBuffer<DrawElementsIndirectCommand>& commands, size_t first, size_t count, const TypedBuffer<u32>& instance_offsets) const {
+    DEBUG_ASSERT(first + count <= commands.element_count());
+    if(!count) {
+        return;
+    }
+
     setup();
-    glDrawElementsInstanced(GL_TRIANGLES, int(_index_buffer.element_count()), GL_UNSIGNED_INT, nullptr, int(count));
+
+    commands.bind(BufferUsage::DrawIndirect);
+
+    instance_offsets.bind(BufferUsage::Attribute);
+    glVertexAttribIPointer(7, 1, GL_UNSIGNED_INT, sizeof(u32), nullptr);
+    glVertexAttribDivisor(7, 1);
+    glEnableVertexAttribArray(7);
+
+    glMultiDrawElementsIndirect(GL_TRIANGLES, gl_index_type(), reinterpret_cast<void*>(first * sizeof(DrawElementsIndirectCommand)), int(count), 0);
+
+    glDisableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 0);
+}
+
+VertexFormat StaticMesh::vertex_format() const {
+    return _format;
+}
+
+IndexType StaticMesh::index_type() const {
+    return _index_type;
+}
+
+size_t StaticMesh::triangle_count(u32 lod) const {
+    return _lods[lod].index_count / 3;
+}
+
+Span<const MeshLod> StaticMesh::lods() const {
+    return _lods;
+}
+
+Span<const Meshlet> StaticMesh::meshlets() const {
+    return _meshlets;
+}
+
+const OccluderMesh& StaticMesh::occluder() const {
+    if(_has_occluder) {
+        return _occluder;
+    }
+    _has_occluder = true;
+
+    const MeshLod& lod = _lods.back();
+    if(!lod.index_count) {
+        return _occluder;
+    }
+
+    std::vector<u32> indices(lod.index_count);
+    if(_index_type == IndexType::U16) {
+        std::vector<u16> narrow_indices(lod.index_count);
+        _index_buffer.read(lod.first_index * sizeof(u16), narrow_indices.size() * sizeof(u16), narrow_indices.data());
+        std::copy(narrow_indices.begin(), narrow_indices.end(), indices.begin());
+    } else {
+        _index_buffer.read(lod.first_index * sizeof(u32), indices.size() * sizeof(u32), indices.data());
+    }
+
+    // Only the range of vertices used by the LOD is read back
+    const auto [min_index, max_index] = std::minmax_element(indices.begin(), indices.end());
+    const size_t stride = _format == VertexFormat::Quantized ? _quantized_layout.stride : vertex_size(_format);
+    std::vector<u8> vertices((*max_index - *min_index + 1) * stride);
+    _vertex_buffer.read(*min_index * stride, vertices.size(), vertices.data());
+
+    _occluder = build_occluder(_format, vertices, *min_index, _dequantization, _quantized_layout, indices);
+    return _occluder;
+}
+
+u32 StaticMesh::gl_index_type() const {
+    return _index_type == IndexType::U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 }
 
 }
@@ -4,6 +4,10 @@
 #include <graphics.h>
 #include <TypedBuffer.h>
 #include <Vertex.h>
+#include <Meshlet.h>
+#include <MeshSimplification.h>
+#include <Bounds.h>
+#include <SoftwareOcclusion.h>
 
 #include <vector>
 
@@ -12,6 +16,21 @@ namespace OM3D {
 struct MeshData {
     std::vector<Vertex> vertices;
     std::vector<u32> indices;
+
+    size_t hash() const;
+    MeshBounds bounds() const;
+
+    // Indices as u16 if smallest_index_type allows it, empty otherwise
+    std::vector<u16> narrow_indices() const;
+};
+
+// Matches the layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    u32 count;
+    u32 instance_count;
+    u32 first_index;
+    i32 base_vertex;
+    u32 base_instance;
 };
 
 class StaticMesh : NonCopyable {
@@ -22,18 +41,61 @@ class StaticMesh : NonCopyable {
         StaticMesh& operator=(StaticMesh&&) = default;
 
         StaticMesh(const MeshData& data);
+        StaticMesh(const MeshData& data, size_t hash, const MeshBounds& bounds);
+        StaticMesh(Span<const Vertex> vertices, Span<const u32> indices, size_t hash, const MeshBounds& bounds);
+        StaticMesh(VertexFormat format, Span<const u8> vertices, const PositionDequantization& dequantization, const QuantizedLayout& quantized_layout, IndexType index_type, Span<const u8> indices, Span<const Meshlet> meshlets, Span<const MeshLod> lods, size_t hash, const MeshBounds& bounds);
 
         void setup() const;
         void draw() const;
-        void draw_instanced(size_t count) const;
+        void draw_instanced(size_t count, u32 lod = 0) const;
+
+        // Draws index ranges (first_index and count are in indices).
+        // Core GL 4.5 only exposes gl_BaseInstance through ARB_shader_draw_parameters, which we don't depend on:
+        // base_instance is read by the shader through `instance_indices` instead, which must hold the identity
+        // sequence up to the largest base_instance
+        void draw_indirect(Span<const DrawElementsIndirectCommand> commands, const TypedBuffer<u32>& instance_indices) const;
+
+        // Draws `count` commands of a GPU written buffer from `first`. `instance_offsets` is fetched per instance,
+        // from each command's base_instance, and added to gl_InstanceID by the shader
+        void draw_indirect(const TypedBuffer<DrawElementsIndirectCommand>& commands, size_t first, size_t count, const TypedBuffer<u32>& instance_offsets) const;
+
+        VertexFormat vertex_format() const;
+        IndexType index_type() const;
+        size_t triangle_count(u32 lod = 0) const;
+
+        // Always contains at least the full resolution mesh
+        Span<const MeshLod> lods() const;
+
+        // Sorted by first_index, empty if the mesh wasn't split into meshlets. Only cover the first LOD
+        Span<const Meshlet> meshlets() const;
+
+        // Coarsest LOD with decoded positions, drawn into the CPU occlusion buffer.
+        // Read back from the GPU buffers the first time it's needed, so only meshes used as occluders pay for it
+        const OccluderMesh& occluder() const;
 
     public:
-        float radius;
+        MeshBounds bounds;
         const size_t hash;
 
     private:
-        TypedBuffer<Vertex> _vertex_buffer;
-        TypedBuffer<u32> _index_buffer;
+        void setup_compact() const;
+        void setup_quantized() const;
+        u32 gl_index_type() const;
+
+        ByteBuffer _vertex_buffer;
+        ByteBuffer _index_buffer;
+        IndexType _index_type = IndexType::U32;
+        size_t _index_count = 0;
+
+        VertexFormat _format = VertexFormat::Float;
+        PositionDequantization _dequantization;
+        QuantizedLayout _quantized_layout;
+
+        std::vector<Meshlet> _meshlets;
+        std::vector<MeshLod> _lods;
+
+        mutable OccluderMesh _occluder;
+        mutable bool _has_occluder = false;
 };
 
 }
@@ -10,27 +10,47 @@
 
 namespace OM3D {
 
-Result<TextureData> TextureData::from_file(const std::string& file) {
-    int width = 0;
-    int height = 0;
-    int channels = 0;
-    u8* img = stbi_load(file.c_str(), &width, &height, &channels, 4);
-    DEFER(stbi_image_free(img));
+void PixelDeleter::operator()(u8* ptr) const {
+    if(stb_allocated) {
+        stbi_image_free(ptr);
+    } else {
+        delete[] ptr;
+    }
+}
+
+static Result<TextureData> adopt_stb_image(u8* img, int width, int height, int channels) {
+    PixelDeleter deleter;
+    deleter.stb_allocated = true;
+    PixelBuffer pixels(img, deleter);
+
     if(!img || width <= 0 || height <= 0 || channels <= 0) {
         return {false, {}};
     }
 
-    const size_t bytes = width * height * 4;
-
     TextureData data;
     data.size = glm::uvec2(width, height);
     data.format = ImageFormat::RGBA8_UNORM;
-    data.data = std::make_unique<u8[]>(bytes);
-    std::copy_n(img, bytes, data.data.get());
+    data.data = std::move(pixels);
 
     return {true, std::move(data)};
 }
 
+Result<TextureData> TextureData::from_file(const std::string& file) {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    u8* img = stbi_load(file.c_str(), &width, &height, &channels, 4);
+    return adopt_stb_image(img, width, height, channels);
+}
+
+Result<TextureData> TextureData::from_memory(Span<const u8> encoded) {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    u8* img = stbi_load_from_memory(encoded.data(), int(encoded.size()), &width, &height, &channels, 4);
+    return adopt_stb_image(img, width, height, channels);
+}
+
 
 
 static GLuint create_texture_handle() {
@@ -39,15 +59,39 @@ static GLuint create_texture_handle() {
     return handle;
 }
 
-Texture::Texture(const TextureData& data) :
+Texture::Texture(const TextureData& data) : Texture(data.size, data.format, Span<const u8>(data.data.get(), image_byte_size(data.format, data.size, data.mip_levels)), data.mip_levels) {
+}
+
+Texture::Texture(const glm::uvec2& size, ImageFormat format, Span<const u8> data, u32 data_mip_levels) :
     _handle(create_texture_handle()),
-    _size(data.size),
-    _format(data.format) {
+    _size(size),
+    _format(format) {
+
+    const u32 levels = mip_levels(_size);
+    const bool compressed = is_block_compressed(_format);
+
+    ALWAYS_ASSERT(data_mip_levels && data_mip_levels <= levels, "Invalid texture mip level count");
+    ALWAYS_ASSERT(data.size() == image_byte_size(_format, _size, data_mip_levels), "Invalid texture data size");
+    ALWAYS_ASSERT(!compressed || data_mip_levels == levels, "Compressed textures need a full mip chain");
 
     const ImageFormatGL gl_format = image_format_to_gl(_format);
-    glTextureStorage2D(_handle.get(), mip_levels(_size), gl_format.internal_format, _size.x, _size.y);
-    glTextureSubImage2D(_handle.get(), 0, 0, 0, _size.x, _size.y, gl_format.format, gl_format.component_type, data.data.get());
-    glGenerateTextureMipmap(_handle.get());
+    glTextureStorage2D(_handle.get(), levels, gl_format.internal_format, _size.x, _size.y);
+
+    const u8* level_data = data.data();
+    for(u32 i = 0; i != data_mip_levels; ++i) {
+        const glm::uvec2 level_size = mip_size(_size, i);
+        const size_t level_bytes = image_byte_size(_format, level_size);
+        if(compressed) {
+            glCompressedTextureSubImage2D(_handle.get(), i, 0, 0, level_size.x, level_size.y, gl_format.internal_format, GLsizei(level_bytes), level_data);
+        } else {
+            glTextureSubImage2D(_handle.get(), i, 0, 0, level_size.x, level_size.y, gl_format.format, gl_format.component_type, level_data);
+        }
+        level_data += level_bytes;
+    }
+
+    if(data_mip_levels != levels) {
+        glGenerateTextureMipmap(_handle.get());
+    }
 }
 
 Texture::Texture(const glm::uvec2 &size, ImageFormat format) :
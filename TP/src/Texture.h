@@ -12,12 +12,28 @@
 
 namespace OM3D {
 
+// Pixels are either allocated with new[] or adopted from stb_image without copying
+struct PixelDeleter {
+    PixelDeleter() = default;
+    PixelDeleter(std::default_delete<u8[]>) {}
+
+    void operator()(u8* ptr) const;
+
+    bool stb_allocated = false;
+};
+
+using PixelBuffer = std::unique_ptr<u8[], PixelDeleter>;
+
 struct TextureData {
-    std::unique_ptr<u8[]> data;
+    // Every mip level, tightly packed starting from the largest one
+    PixelBuffer data;
     glm::uvec2 size = {};
     ImageFormat format;
+    u32 mip_levels = 1;
 
     static Result<TextureData> from_file(const std::string& file_name);
+    // Decodes an encoded image (PNG, JPEG...) to RGBA8_UNORM, thread safe
+    static Result<TextureData> from_memory(Span<const u8> encoded);
 };
 
 class Texture {
@@ -30,6 +46,8 @@ class Texture {
         ~Texture();
 
         Texture(const TextureData& data);
+        // Missing mip levels are generated by the driver (uncompressed formats only)
+        Texture(const glm::uvec2& size, ImageFormat format, Span<const u8> data, u32 data_mip_levels = 1);
         Texture(const glm::uvec2 &size, ImageFormat format);
 
         void bind(u32 index) const;
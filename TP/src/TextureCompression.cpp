@@ -0,0 +1,106 @@
+#include "TextureCompression.h"
+
+#include <JobSystem.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb/stb_dxt.h>
+
+namespace OM3D {
+
+static void compress_level(const u8* rgba, const glm::uvec2& size, ImageFormat format, int mode, u8* out) {
+    const u32 blocks_x = (size.x + 3) / 4;
+    const u32 blocks_y = (size.y + 3) / 4;
+    const size_t block_bytes = image_byte_size(format, glm::uvec2(4));
+
+    parallel_for(blocks_y, [&](size_t by) {
+        u8 block[16 * 4] = {};
+        u8 rg_block[16 * 2] = {};
+
+        for(u32 bx = 0; bx != blocks_x; ++bx) {
+            // Gather the 4x4 block, clamping on the edges of the image
+            for(u32 y = 0; y != 4; ++y) {
+                const u32 py = std::min(u32(by) * 4 + y, size.y - 1);
+                for(u32 x = 0; x != 4; ++x) {
+                    const u32 px = std::min(bx * 4 + x, size.x - 1);
+                    std::memcpy(block + (y * 4 + x) * 4, rgba + (size_t(py) * size.x + px) * 4, 4);
+                }
+            }
+
+            u8* dst = out + (by * blocks_x + bx) * block_bytes;
+            switch(format) {
+                case ImageFormat::BC5_UNORM:
+                    for(u32 i = 0; i != 16; ++i) {
+                        rg_block[i * 2 + 0] = block[i * 4 + 0];
+                        rg_block[i * 2 + 1] = block[i * 4 + 1];
+                    }
+                    stb_compress_bc5_block(dst, rg_block);
+                break;
+
+                case ImageFormat::BC3_UNORM:
+                case ImageFormat::BC3_sRGB:
+                    stb_compress_dxt_block(dst, block, 1, mode);
+                break;
+
+                default:
+                    stb_compress_dxt_block(dst, block, 0, mode);
+                break;
+            }
+        }
+    });
+}
+
+Result<TextureData> compress_texture(const TextureData& texture, bool is_normal_map, TextureCompression quality, MipFilter mip_filter) {
+    if(quality == TextureCompression::None) {
+        return {false, {}};
+    }
+
+    // Mips are filtered before compression, in linear space for sRGB textures
+    const TextureData* mips = &texture;
+    Result<TextureData> generated = {false, {}};
+    if(texture.mip_levels != Texture::mip_levels(texture.size) || (texture.format != ImageFormat::RGBA8_UNORM && texture.format != ImageFormat::RGBA8_sRGB)) {
+        generated = generate_mips(texture, mip_filter, is_normal_map);
+        if(!generated.is_ok) {
+            return {false, {}};
+        }
+        mips = &generated.value;
+    }
+
+    const bool sRGB = mips->format == ImageFormat::RGBA8_sRGB;
+    const bool has_alpha = !is_normal_map && [&] {
+        const size_t top_level_bytes = image_byte_size(mips->format, mips->size);
+        for(size_t i = 3; i < top_level_bytes; i += 4) {
+            if(mips->data[i] != 255) {
+                return true;
+            }
+        }
+        return false;
+    }();
+
+    TextureData compressed;
+    compressed.size = texture.size;
+    compressed.mip_levels = Texture::mip_levels(texture.size);
+    compressed.format = is_normal_map
+        ? ImageFormat::BC5_UNORM
+        : has_alpha
+            ? (sRGB ? ImageFormat::BC3_sRGB : ImageFormat::BC3_UNORM)
+            : (sRGB ? ImageFormat::BC1_sRGB : ImageFormat::BC1_UNORM);
+    compressed.data = std::make_unique<u8[]>(image_byte_size(compressed.format, compressed.size, compressed.mip_levels));
+
+    const int mode = quality == TextureCompression::HighQuality ? STB_DXT_HIGHQUAL : STB_DXT_NORMAL;
+
+    const u8* in = mips->data.get();
+    u8* out = compressed.data.get();
+    for(u32 i = 0; i != compressed.mip_levels; ++i) {
+        const glm::uvec2 level_size = mip_size(compressed.size, i);
+        compress_level(in, level_size, compressed.format, mode, out);
+        in += image_byte_size(mips->format, level_size);
+        out += image_byte_size(compressed.format, level_size);
+    }
+
+    return {true, std::move(compressed)};
+}
+
+}
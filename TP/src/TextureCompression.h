@@ -0,0 +1,21 @@
+#ifndef TEXTURECOMPRESSION_H
+#define TEXTURECOMPRESSION_H
+
+#include <MipGeneration.h>
+
+namespace OM3D {
+
+enum class TextureCompression {
+    None,
+    Fast,
+    HighQuality,
+};
+
+// Block compresses an 8 bit RGB(A) texture along with its full mip chain (generated with `mip_filter` if missing):
+// BC1 for color (BC3 if alpha is actually used) and BC5 for normal maps, which only keep their RG channels.
+// Blocks are encoded across all hardware threads.
+Result<TextureData> compress_texture(const TextureData& texture, bool is_normal_map, TextureCompression quality, MipFilter mip_filter = MipFilter::Kaiser);
+
+}
+
+#endif // TEXTURECOMPRESSION_H
@@ -7,6 +7,8 @@
 
 #include <utils.h>
 
+#include <limits>
+
 namespace OM3D {
 
 struct Vertex {
@@ -17,6 +19,89 @@ struct Vertex {
     glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f); // to avoid completly black meshes if no color is present
 };
 
+// Quantized vertex, see compress_vertices
+struct CompactVertex {
+    u16 position[4];            // unorm16 relative to the mesh bounds, w is the bitangent sign (0 for negative)
+    i16 normal[2];              // octahedral snorm16
+    i16 tangent[2];             // octahedral snorm16
+    u16 uv[2];                  // half float
+};
+
+static_assert(sizeof(CompactVertex) == 20);
+
+enum class VertexFormat : u32 {
+    Float,          // Vertex
+    Compact,        // CompactVertex
+    CompactColor,   // CompactVertex followed by an RGBA8 color
+    Quantized,      // Described by a QuantizedLayout
+};
+
+// Values match glTF's componentType and the GL type enums
+enum class ComponentType : u32 {
+    Byte = 5120,
+    UnsignedByte = 5121,
+    Short = 5122,
+    UnsignedShort = 5123,
+    Float = 5126,
+};
+
+inline size_t component_size(ComponentType type) {
+    switch(type) {
+        case ComponentType::Byte:
+        case ComponentType::UnsignedByte: return 1;
+        case ComponentType::Short:
+        case ComponentType::UnsignedShort: return 2;
+        case ComponentType::Float: return 4;
+    }
+    return 0;
+}
+
+// Attribute kept in the component type of its source file (KHR_mesh_quantization), absent if it has no components
+struct QuantizedAttrib {
+    ComponentType type = ComponentType::Float;
+    u8 components = 0;
+    u8 normalized = 0;
+    u16 offset = 0;
+};
+
+// Interleaved layout of VertexFormat::Quantized vertices, every attribute is 4 byte aligned
+struct QuantizedLayout {
+    // Indexed by attribute location: position, normal, uv, tangent / bitangent sign, color
+    QuantizedAttrib attribs[5];
+    u32 stride = 0;
+};
+
+// 0 for VertexFormat::Quantized, whose size depends on its layout
+inline size_t vertex_size(VertexFormat format) {
+    switch(format) {
+        case VertexFormat::Float: return sizeof(Vertex);
+        case VertexFormat::Compact: return sizeof(CompactVertex);
+        case VertexFormat::CompactColor: return sizeof(CompactVertex) + 4;
+        case VertexFormat::Quantized: return 0;
+    }
+    return 0;
+}
+
+enum class IndexType : u32 {
+    U16,
+    U32,
+};
+
+inline size_t index_size(IndexType type) {
+    return type == IndexType::U16 ? sizeof(u16) : sizeof(u32);
+}
+
+// 16 bit indices whenever they can address every vertex
+inline IndexType smallest_index_type(size_t vertex_count) {
+    return vertex_count <= size_t(std::numeric_limits<u16>::max()) + 1 ? IndexType::U16 : IndexType::U32;
+}
+
+// Maps quantized positions back to object space: position = offset + quantized * scale
+struct PositionDequantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
 }
 
 namespace std {
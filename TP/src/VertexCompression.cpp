@@ -0,0 +1,149 @@
+#include "VertexCompression.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace OM3D {
+
+static i16 encode_snorm16(float x) {
+    return i16(std::round(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+}
+
+// Must match oct_decode in utils.glsl
+static glm::vec2 oct_encode(glm::vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 e(n.x, n.y);
+    if(n.z < 0.0f) {
+        e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return e;
+}
+
+static void encode_direction(const glm::vec3& dir, i16* out) {
+    const float len = glm::length(dir);
+    const glm::vec2 e = len > 0.0f ? oct_encode(dir / len) : glm::vec2(0.0f);
+    out[0] = encode_snorm16(e.x);
+    out[1] = encode_snorm16(e.y);
+}
+
+template<typename T>
+static void encode_integer(float x, bool normalized, u8* out) {
+    const float min = float(std::numeric_limits<T>::min());
+    const float max = float(std::numeric_limits<T>::max());
+    const T value = T(std::round(std::clamp(normalized ? x * max : x, min, max)));
+    std::memcpy(out, &value, sizeof(value));
+}
+
+static void encode_component(float x, const QuantizedAttrib& attrib, u8* out) {
+    switch(attrib.type) {
+        case ComponentType::Byte: encode_integer<i8>(x, attrib.normalized, out); break;
+        case ComponentType::UnsignedByte: encode_integer<u8>(x, attrib.normalized, out); break;
+        case ComponentType::Short: encode_integer<i16>(x, attrib.normalized, out); break;
+        case ComponentType::UnsignedShort: encode_integer<u16>(x, attrib.normalized, out); break;
+        case ComponentType::Float: std::memcpy(out, &x, sizeof(x)); break;
+    }
+}
+
+CompactVertexData compress_vertices(Span<const Vertex> vertices) {
+    CompactVertexData compact;
+    if(vertices.is_empty()) {
+        return compact;
+    }
+
+    const bool has_color = std::any_of(vertices.begin(), vertices.end(), [](const Vertex& v) { return v.color != glm::vec3(1.0f); });
+    compact.format = has_color ? VertexFormat::CompactColor : VertexFormat::Compact;
+
+    glm::vec3 min = vertices[0].position;
+    glm::vec3 max = vertices[0].position;
+    for(const Vertex& v : vertices) {
+        min = glm::min(min, v.position);
+        max = glm::max(max, v.position);
+    }
+
+    const glm::vec3 extent = max - min;
+    compact.dequantization.offset = min;
+    compact.dequantization.scale = glm::vec3(
+        extent.x > 0.0f ? extent.x : 1.0f,
+        extent.y > 0.0f ? extent.y : 1.0f,
+        extent.z > 0.0f ? extent.z : 1.0f
+    );
+
+    const size_t stride = vertex_size(compact.format);
+    compact.vertices.resize(vertices.size() * stride);
+
+    u8* out = compact.vertices.data();
+    for(const Vertex& v : vertices) {
+        CompactVertex c = {};
+
+        const glm::vec3 p = glm::clamp((v.position - compact.dequantization.offset) / compact.dequantization.scale, 0.0f, 1.0f);
+        for(int i = 0; i != 3; ++i) {
+            c.position[i] = u16(std::round(p[i] * 65535.0f));
+        }
+        c.position[3] = v.tangent_bitangent_sign.w > 0.0f ? u16(65535) : u16(0);
+
+        encode_direction(v.normal, c.normal);
+        encode_direction(glm::vec3(v.tangent_bitangent_sign), c.tangent);
+
+        const u32 uv = glm::packHalf2x16(v.uv);
+        c.uv[0] = u16(uv & 0xFFFF);
+        c.uv[1] = u16(uv >> 16);
+
+        std::memcpy(out, &c, sizeof(c));
+        if(has_color) {
+            const glm::vec3 color = glm::clamp(v.color, 0.0f, 1.0f);
+            const u8 rgba[] = {
+                u8(std::round(color.r * 255.0f)),
+                u8(std::round(color.g * 255.0f)),
+                u8(std::round(color.b * 255.0f)),
+                u8(255),
+            };
+            std::memcpy(out + sizeof(c), rgba, sizeof(rgba));
+        }
+        out += stride;
+    }
+
+    return compact;
+}
+
+void pack_quantized_layout(QuantizedLayout& layout) {
+    u32 offset = 0;
+    for(QuantizedAttrib& attrib : layout.attribs) {
+        attrib.offset = u16(offset);
+        const u32 size = u32(attrib.components * component_size(attrib.type));
+        offset += (size + 3) / 4 * 4;
+    }
+    layout.stride = offset;
+}
+
+std::vector<u8> quantize_vertices(Span<const Vertex> vertices, const QuantizedLayout& layout) {
+    std::vector<u8> quantized(vertices.size() * layout.stride, 0);
+
+    u8* out = quantized.data();
+    for(const Vertex& v : vertices) {
+        const glm::vec4 values[] = {
+            glm::vec4(v.position, 1.0f),
+            glm::vec4(v.normal, 0.0f),
+            glm::vec4(v.uv, 0.0f, 0.0f),
+            v.tangent_bitangent_sign,
+            glm::vec4(v.color, 1.0f),
+        };
+
+        for(size_t i = 0; i != std::size(layout.attribs); ++i) {
+            const QuantizedAttrib& attrib = layout.attribs[i];
+            for(u32 c = 0; c != attrib.components; ++c) {
+                encode_component(values[i][c], attrib, out + attrib.offset + c * component_size(attrib.type));
+            }
+        }
+        out += layout.stride;
+    }
+
+    return quantized;
+}
+
+}
@@ -0,0 +1,28 @@
+#ifndef VERTEXCOMPRESSION_H
+#define VERTEXCOMPRESSION_H
+
+#include <Vertex.h>
+
+#include <vector>
+
+namespace OM3D {
+
+struct CompactVertexData {
+    std::vector<u8> vertices;
+    VertexFormat format = VertexFormat::Compact;
+    PositionDequantization dequantization;
+};
+
+// Quantizes vertices to CompactVertex: positions relative to the mesh bounds, octahedral normals and tangents and half float UVs.
+// Colors are only kept (as RGBA8) if at least one vertex isn't white.
+CompactVertexData compress_vertices(Span<const Vertex> vertices);
+
+// Assigns attribute offsets (in location order, 4 byte aligned) and the stride from the attribute types
+void pack_quantized_layout(QuantizedLayout& layout);
+
+// Encodes vertices with the layout's component types, which is lossless for values decoded from the same types
+std::vector<u8> quantize_vertices(Span<const Vertex> vertices, const QuantizedLayout& layout);
+
+}
+
+#endif // VERTEXCOMPRESSION_H
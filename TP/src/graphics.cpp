@@ -35,6 +35,9 @@ u32 buffer_usage_to_gl(BufferUsage usage) {
 
         case BufferUsage::Storage:
             return GL_SHADER_STORAGE_BUFFER;
+
+        case BufferUsage::DrawIndirect:
+            return GL_DRAW_INDIRECT_BUFFER;
     }
 
     FATAL("Unknown usage value");
@@ -90,6 +93,9 @@ void init_graphics() {
         glClearDepthf(0.0f);
     }
 
+    // Texture data is always tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
     glGenVertexArrays(1, &global_vao);
     glBindVertexArray(global_vao);
 
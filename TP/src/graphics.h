@@ -47,6 +47,7 @@ enum class BufferUsage {
     Index,
     Uniform,
     Storage,
+    DrawIndirect,
 };
 
 enum class AccessType {
@@ -5,15 +5,23 @@
 
 #include <iostream>
 #include <filesystem>
+#include <cstring>
 #include <optional>
 #include <vector>
+#include <array>
 
 #include <graphics.h>
 #include <SceneView.h>
+#include <AsyncSceneLoader.h>
 #include <Texture.h>
 #include <Framebuffer.h>
 #include <ImGuiRenderer.h>
 #include <Material.h>
+#include <FrameAllocator.h>
+#include <GPUTimer.h>
+#include <LightClusters.h>
+#include <SoftwareOcclusion.h>
+#include <MeshoptDecoder.h>
 
 #include <imgui/imgui.h>
 
@@ -23,12 +31,16 @@ using namespace OM3D;
 static float delta_time = 0.0f;
 const glm::uvec2 window_size(1600, 900);
 
+// Time spent uploading a scene being loaded in the background, per frame
+const double scene_upload_budget_ms = 4.0;
+
 const auto FORWARD_PIPELINE = std::pair{"basic_lit.frag", "basic.vert"};
 const auto DEFERRED_PIPELINE = std::pair{"gbuffer.frag", "basic.vert"};
 
 auto current_scene = std::optional<std::filesystem::path>();
 auto scene_paths = std::vector<std::filesystem::path>();
 auto current_pipeline = DEFERRED_PIPELINE;
+auto import_settings = SceneImportSettings();
 
 
 void glfw_check(bool cond) {
@@ -109,7 +121,7 @@ std::unique_ptr<Scene> create_default_scene() {
 
     // Load default cube model
     const auto cube_scene_path = std::string(data_path) + "scenes/cube_lights.glb";
-    auto result = Scene::from_gltf(cube_scene_path, current_pipeline);
+    auto result = Scene::from_gltf(cube_scene_path, current_pipeline, {}, import_settings);
     if (result.is_ok) {
         current_scene.emplace(cube_scene_path);
     }
@@ -120,9 +132,17 @@ std::unique_ptr<Scene> create_default_scene() {
 }
 
 
-int main(int, char**) {
+int main(int argc, char** argv) {
     DEBUG_ASSERT([] { std::cout << "Debug asserts enabled" << std::endl; return true; }());
 
+    // Runs without a window, the CPU occlusion culling doesn't need one
+    if (argc > 1 && std::strcmp(argv[1], "--occlusion-self-check") == 0) {
+        return occlusion_self_check() ? 0 : 1;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--meshopt-benchmark") == 0) {
+        return meshopt_benchmark() ? 0 : 1;
+    }
+
     glfw_check(glfwInit());
     DEFER(glfwTerminate());
 
@@ -149,20 +169,31 @@ int main(int, char**) {
         }
     }
 
+    // Transient per-frame GPU data, destroyed before the context
+    FrameAllocator frame_allocator;
+
     ImGuiRenderer imgui(window);
     bool debug = false;
     bool debug_updated = false;
     int debug_shader = 0;
     bool debug_light_cull = false;
     bool deferred_rendering = true;
+    // 0: one additive sphere per light, 1: tiled compute shader
+    int deferred_lighting = 0;
+    // Forward only: fragments loop over the lights of their cluster instead of every light
+    bool clustered_lighting = true;
     bool tonemapping = true;
 
+    RenderSettings render_settings;
     RenderInfo render_info;
     size_t rendered_point_lights = 0;
 
     std::unique_ptr<Scene> scene = create_default_scene();
     SceneView scene_view(scene.get());
 
+    // Scene being loaded in the background, the current one is rendered until it is ready
+    std::unique_ptr<AsyncSceneLoader> scene_loader;
+
     auto sphere_scene = Scene::from_gltf(std::string(data_path) + "meshes/sphere.glb", current_pipeline);
     ALWAYS_ASSERT(sphere_scene.is_ok, "Unable to load sphere");
     auto sphere = sphere_scene.value->get_objects()[0].get_mesh();
@@ -175,6 +206,7 @@ int main(int, char**) {
     auto normal = std::make_shared<Texture>(window_size, ImageFormat::RGBA8_UNORM);
     auto depth = std::make_shared<Texture>(window_size, ImageFormat::Depth32_FLOAT);
     Framebuffer gbuffer(depth.get(), std::array{albedo.get(), normal.get()});
+    render_settings.depth = depth.get();
 
     auto lit = std::make_shared<Texture>(window_size, ImageFormat::RGBA16_FLOAT);
     Framebuffer main_framebuffer(depth.get(), std::array{lit.get()});
@@ -212,6 +244,49 @@ int main(int, char**) {
 
     auto debug_lc_program = Program::from_files("lit.frag", "basic.vert", std::vector<std::string>{"LIGHT_CULL", "DEBUG_LIGHT_CULL"});
 
+    auto tiled_lighting_program = Program::from_file("tiled_lighting.comp");
+    // MAX_TILE_LIGHTS of tiled_lighting.comp, tiles with more lights drop the others and are counted, one counter
+    // per frame in flight so that they are read once the frame is done
+    constexpr u32 max_tile_lights = 1024;
+    std::array<TypedBuffer<u32>, FrameAllocator::frames_in_flight> tile_overflow_counters;
+    for (auto& counter : tile_overflow_counters) {
+        counter = TypedBuffer<u32>(std::array<u32, 1>{});
+    }
+    u32 overflowed_tiles = 0;
+
+    LightClusters light_clusters;
+
+    // Lighting passes of both deferred modes, the last measurement of each is kept to compare them
+    GPUTimer light_volumes_timer;
+    GPUTimer tiled_lighting_timer;
+
+    // Only basic_lit.frag has debug outputs for the scene materials, and not the depth one: the deferred pipeline
+    // shows them in lit.frag and gbuffer.frag ignores them
+    constexpr int forward_debug_shaders = 2;
+
+    // Defines of the scene materials' program, on top of the pipeline
+    auto material_defines = [&] {
+        const bool forward_debug = debug && !deferred_rendering && debug_shader < forward_debug_shaders;
+        return forward_debug ? std::vector<std::string>{debug_defines[debug_shader]} : std::vector<std::string>{};
+    };
+
+    // Every variant the scene can be switched to is compiled up front, switching only rebinds the materials' programs
+    std::vector<std::shared_ptr<Program>> scene_programs;
+    auto compile_scene_programs = [&] {
+        const double start = program_time();
+        scene_programs.clear();
+        for(const auto& pipeline : {FORWARD_PIPELINE, DEFERRED_PIPELINE}) {
+            auto programs = scene->compile_pipeline(pipeline);
+            scene_programs.insert(scene_programs.end(), programs.begin(), programs.end());
+        }
+        for(int i = 0; i != forward_debug_shaders; ++i) {
+            const auto programs = scene->compile_pipeline(FORWARD_PIPELINE, std::array{std::string(debug_defines[i])});
+            scene_programs.insert(scene_programs.end(), programs.begin(), programs.end());
+        }
+        std::cout << scene_programs.size() << " scene programs compiled in " << std::round((program_time() - start) * 1000.0 * 100.0) / 100.0 << "ms" << std::endl;
+    };
+    compile_scene_programs();
+
     for(;;) {
         glfwPollEvents();
         if(glfwWindowShouldClose(window) || glfwGetKey(window, GLFW_KEY_ESCAPE)) {
@@ -219,56 +294,105 @@ int main(int, char**) {
         }
 
         update_delta_time();
+        frame_allocator.begin_frame();
+
+        // LOD errors are measured in pixels of the window, which can be resized. Minimized windows keep the last size
+        {
+            int width = 0;
+            int height = 0;
+            glfwGetFramebufferSize(window, &width, &height);
+            if(height > 0) {
+                render_settings.viewport_height = float(height);
+            }
+        }
+
+        if(scene_loader && scene_loader->update(scene_upload_budget_ms)) {
+            if(!scene_loader->has_failed()) {
+                scene = scene_loader->take_scene();
+                scene->set_pipeline(current_pipeline, material_defines());
+                scene_view = SceneView(scene.get());
+                current_scene = scene_loader->file_name();
+                compile_scene_programs();
+            }
+            scene_loader = nullptr;
+        }
 
         if(const auto& io = ImGui::GetIO(); !io.WantCaptureMouse && !io.WantCaptureKeyboard) {
             process_inputs(window, scene_view.camera());
         }
 
-        const auto framedata_buffer = scene_view.scene()->get_framedata_buffer(window_size, scene_view.camera());
-        framedata_buffer->bind(BufferUsage::Uniform, 0);
-
         const auto lights = scene_view.scene()->get_in_frustum_lights(scene_view.camera());
         const auto lights_buffer = scene_view.scene()->get_lights_buffer(lights);
-        lights_buffer->bind(BufferUsage::Storage, 1);
+        lights_buffer.bind(BufferUsage::Storage, 1);
         rendered_point_lights = lights.size();
 
+        const auto framedata_buffer = scene_view.scene()->get_framedata_buffer(window_size, scene_view.camera(), lights.size());
+        framedata_buffer.bind(BufferUsage::Uniform, 0);
+
         if (!deferred_rendering) {
 
             main_framebuffer.bind();
-            render_info = scene_view.render();
+            light_clusters.build(scene_view.camera(), clustered_lighting);
+            render_info = scene_view.render(render_settings);
 
         } else {
             // Render the scene into the gbuffer
             gbuffer.bind();
-            render_info = scene_view.render();
+            render_info = scene_view.render(render_settings);
 
-            // Ambiant + directional lighting
-            ds_material->bind();
-            main_framebuffer.bind();
-            framedata_buffer->bind(BufferUsage::Uniform, 0);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-
-            if (!debug) {
-                // Light culling
-                lc_material->bind();
+            if (deferred_lighting == 1 && !debug) {
+                // Every light and the sun in one dispatch, background pixels keep the clear color.
+                // Only the color is cleared, the depth is the gbuffer's
                 main_framebuffer.bind(false);
-                
-                // Vertex shader
-                const auto transform_buffer = std::make_shared<TypedBuffer<shader::Model>>(nullptr, std::max(lights.size(), size_t(1)));
-                auto mapping = transform_buffer->map(AccessType::WriteOnly);
-                for(size_t i = 0; i != lights.size(); ++i) {
-                    const auto& light = lights[i];
-                    mapping[i] = { 
-                        glm::translate(glm::mat4(1.0f), light->position()) * glm::scale(glm::mat4(1.0f), glm::vec3(light->radius()))
-                    };
+                glClear(GL_COLOR_BUFFER_BIT);
+                tiled_lighting_timer.begin();
+                {
+                    auto mapping = tile_overflow_counters[frame_allocator.frame_index()].map(AccessType::ReadWrite);
+                    overflowed_tiles = mapping[0];
+                    mapping[0] = 0;
                 }
-                transform_buffer->bind(BufferUsage::Storage, 2);
+                tile_overflow_counters[frame_allocator.frame_index()].bind(BufferUsage::Storage, 12);
+                tiled_lighting_program->bind();
+                albedo->bind(0);
+                normal->bind(1);
+                depth->bind(2);
+                lit->bind_as_image(0, AccessType::WriteOnly);
+                framedata_buffer.bind(BufferUsage::Uniform, 0);
+                lights_buffer.bind(BufferUsage::Storage, 1);
+                glDispatchCompute((window_size.x + 15) / 16, (window_size.y + 15) / 16, 1);
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+                tiled_lighting_timer.end();
+            } else {
+                light_volumes_timer.begin();
+
+                // Ambiant + directional lighting
+                ds_material->bind();
+                main_framebuffer.bind();
+                framedata_buffer.bind(BufferUsage::Uniform, 0);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+
+                if (!debug) {
+                    // Light culling
+                    lc_material->bind();
+                    main_framebuffer.bind(false);
+
+                    // Vertex shader
+                    const auto transform_buffer = frame_allocator.allocate<shader::Model>(lights.size(), BufferUsage::Storage);
+                    for(size_t i = 0; i != lights.size(); ++i) {
+                        const auto& light = lights[i];
+                        transform_buffer[i] = {
+                            glm::translate(glm::mat4(1.0f), light->position()) * glm::scale(glm::mat4(1.0f), glm::vec3(light->radius()))
+                        };
+                    }
+                    transform_buffer.bind(BufferUsage::Storage, 2);
+
+                    // Fragment shader
+                    lights_buffer.bind(BufferUsage::Storage, 1);
 
-                // Fragment shader
-                const auto light_buffer = scene_view.scene()->get_lights_buffer(lights);
-                light_buffer->bind(BufferUsage::Storage, 1);
+                    sphere->draw_instanced(lights.size());
+                }
 
-                sphere->draw_instanced(lights.size());
+                light_volumes_timer.end();
             }
         }
 
@@ -287,20 +411,12 @@ int main(int, char**) {
         imgui.start();
         {
             for (const auto& path : scene_paths) {
-                bool disabled = path == current_scene;
+                bool disabled = path == current_scene || scene_loader;
                 if (disabled) {
                     ImGui::BeginDisabled();
                 }
                 if (ImGui::Button(path.filename().string().c_str())) {
-                    auto result = Scene::from_gltf(path.string(), current_pipeline);
-                    if(!result.is_ok) {
-                        std::cerr << "Unable to load scene (" << path.string() << ")" << std::endl;
-                    } else {
-                        scene = std::move(result.value);
-                        scene_view = SceneView(scene.get());
-                        current_scene = path;
-                    }
-                    deferred_rendering = true;
+                    scene_loader = Scene::from_gltf_async(path.string(), current_pipeline, {}, import_settings);
                 }
                 if (disabled) {
                     ImGui::EndDisabled();
@@ -308,25 +424,87 @@ int main(int, char**) {
                 ImGui::SameLine();
             }
             ImGui::NewLine();
+            if (scene_loader) {
+                ImGui::Text("Loading %s (%d%%)", std::filesystem::path(scene_loader->file_name()).filename().string().c_str(), int(scene_loader->progress() * 100.0f));
+            }
             ImGui::NewLine();
 
-            if (ImGui::Checkbox("Deferred rendering", &deferred_rendering) || (!deferred_rendering && debug_updated)) {
-                current_pipeline = deferred_rendering ? DEFERRED_PIPELINE : FORWARD_PIPELINE;
-                auto result = Scene::from_gltf(current_scene->string(), current_pipeline,
-                    debug ? Span<const std::string>{debug_defines[debug_shader]} : Span<const std::string>{});
-                if(!result.is_ok) {
-                    std::cerr << "Unable to reload scene (" << current_scene->string() << ")" << std::endl;
-                } else {
-                    scene = std::move(result.value);
-                    scene_view.set_scene(scene.get());
-                    std::cout << "Set rendering pipeline to: {\"" << current_pipeline.first << "\", \"" << current_pipeline.second << "\"}" << std::endl;
-                }
+            if (scene_loader) {
+                ImGui::BeginDisabled();
+            }
+            const bool pipeline_changed = ImGui::Checkbox("Deferred rendering", &deferred_rendering);
+            if (scene_loader) {
+                ImGui::EndDisabled();
             }
-            if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
-                ImGui::SetTooltip("Warning: reloads entire scene");
+            if (pipeline_changed || (!deferred_rendering && debug_updated)) {
+                current_pipeline = deferred_rendering ? DEFERRED_PIPELINE : FORWARD_PIPELINE;
+                const double start = program_time();
+                scene->set_pipeline(current_pipeline, material_defines());
+                std::cout << "Set rendering pipeline to: {\"" << current_pipeline.first << "\", \"" << current_pipeline.second << "\"} in "
+                          << std::round((program_time() - start) * 1000.0 * 1000.0) / 1000.0 << "ms" << std::endl;
             }
 
             ImGui::Checkbox("Tonemapping", &tonemapping);
+            ImGui::Checkbox("GPU-driven rendering", &render_settings.gpu_driven);
+            if (render_settings.gpu_driven) {
+                ImGui::Checkbox("Occlusion culling", &render_settings.occlusion_culling);
+            } else {
+                ImGui::Checkbox("Software occlusion culling", &render_settings.software_occlusion);
+            }
+            ImGui::Checkbox("BVH culling", &render_settings.bvh_culling);
+            ImGui::Checkbox("Meshlet culling", &render_settings.meshlet_culling);
+            ImGui::Checkbox("LOD selection", &render_settings.lod_selection);
+            if (render_settings.lod_selection) {
+                ImGui::SliderFloat("LOD pixel error", &render_settings.lod_pixel_error, 0.1f, 16.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            }
+
+            {
+                const char* compression_modes[] = {"None", "Fast", "High quality"};
+                int compression = int(import_settings.texture_compression);
+                if (ImGui::Combo("Texture compression", &compression, compression_modes, int(std::size(compression_modes)))) {
+                    import_settings.texture_compression = TextureCompression(compression);
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Applied on the next scene load");
+                }
+
+                const char* mip_filters[] = {"Box", "Kaiser"};
+                int mip_filter = int(import_settings.mip_filter);
+                if (ImGui::Combo("Mip filter", &mip_filter, mip_filters, int(std::size(mip_filters)))) {
+                    import_settings.mip_filter = MipFilter(mip_filter);
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Applied on the next scene load");
+                }
+
+                ImGui::Checkbox("Optimize meshes", &import_settings.optimize_meshes);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Applied on the next scene load");
+                }
+
+                ImGui::Checkbox("Compact vertices", &import_settings.compact_vertices);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Applied on the next scene load");
+                }
+
+                ImGui::Checkbox("Build meshlets", &import_settings.build_meshlets);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Applied on the next scene load");
+                }
+
+                int mesh_lods = int(import_settings.mesh_lods);
+                if (ImGui::SliderInt("Mesh LODs", &mesh_lods, 0, 6)) {
+                    import_settings.mesh_lods = u32(mesh_lods);
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Applied on the next scene load");
+                }
+
+                ImGui::SliderFloat("LOD error", &import_settings.lod_error, 0.001f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Simplification error allowed for the first LOD, relative to the mesh size. Applied on the next scene load");
+                }
+            }
             ImGui::NewLine();
 
             debug_updated = ImGui::Checkbox("Debug shader", &debug);
@@ -343,7 +521,22 @@ int main(int, char**) {
                 ds_material->set_program(ds_program);
             }
 
-            if (deferred_rendering && ImGui::Checkbox("Debug light culling", &debug_light_cull)) {
+            if (!deferred_rendering) {
+                ImGui::Checkbox("Clustered lighting", &clustered_lighting);
+            }
+
+            if (deferred_rendering) {
+                ImGui::Text("Deferred lighting:");
+                ImGui::SameLine();
+                ImGui::RadioButton("Light volumes", &deferred_lighting, 0);
+                ImGui::SameLine();
+                ImGui::RadioButton("Tiled", &deferred_lighting, 1);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("At most %u lights per 16x16 tile, the others are dropped", max_tile_lights);
+                }
+            }
+
+            if (deferred_rendering && deferred_lighting == 0 && ImGui::Checkbox("Debug light culling", &debug_light_cull)) {
                 lc_material->set_program(debug_light_cull ? debug_lc_program : lc_program);
                 lc_material->set_depth_test_mode(debug_light_cull ? DepthTestMode::Standard : DepthTestMode::Reversed);
             }
@@ -351,11 +544,29 @@ int main(int, char**) {
 
             ImGui::Text("Render info:");
             ImGui::Text("  - scene objects: %zu", render_info.scene_objects);
+            ImGui::Text("  - objects culled by frustum: %zu", render_info.objects_culled);
+            ImGui::Text("  - objects culled by occlusion: %zu", render_info.objects_occluded);
+            if (!render_settings.gpu_driven && render_settings.software_occlusion) {
+                ImGui::Text("  - software occlusion: %zu triangles, %.2fms", render_info.occluder_triangles, render_info.software_occlusion_ms);
+            }
+            ImGui::Text("  - BVH nodes visited: %zu", render_info.bvh_nodes_visited);
+            ImGui::Text("  - objects tested: %zu (%s)", render_info.objects_tested, simd_level_name(best_simd_level()));
             ImGui::Text("  - draw instanced calls: %zu", render_info.draw_instanced_calls);
+            ImGui::Text("  - triangles submitted: %zu", render_info.triangles_submitted);
+            ImGui::Text("  - triangles culled by meshlets: %zu", render_info.triangles_culled);
+            for (size_t i = 0; i != render_info.lod_objects.size(); ++i) {
+                ImGui::Text("  - objects at LOD %zu: %zu", i, render_info.lod_objects[i]);
+            }
             ImGui::Text("  - points lights: %zu", scene->get_point_light_count());
             ImGui::Text("  - rendered points lights: %zu", rendered_point_lights);
+            ImGui::Text("  - lighting: light volumes %.2fms, tiled %.2fms", light_volumes_timer.last_ms(), tiled_lighting_timer.last_ms());
+            if (deferred_rendering && deferred_lighting == 1) {
+                ImGui::Text("  - tiles over %u lights: %u", max_tile_lights, overflowed_tiles);
+            }
+            ImGui::Text("  - transient memory: %zuKB / %zuKB", frame_allocator.last_frame_byte_size() / 1024, frame_allocator.frame_byte_size() / 1024);
         }
         imgui.finish();
+        frame_allocator.end_frame();
 
         glfwSwapBuffers(window);
     }
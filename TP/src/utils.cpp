@@ -3,6 +3,7 @@
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include <iostream>
 #include <chrono>
@@ -92,4 +93,41 @@ bool ends_with(std::string_view str, std::string_view suffix) {
     return str.substr(str.size() - suffix.size()) == suffix;
 }
 
+
+u64 hash_bytes(const void* data, size_t size, u64 seed) {
+    const u8* bytes = static_cast<const u8*>(data);
+
+    auto mix = [](u64 h, u64 k) {
+        k *= 0x87c37b91114253d5;
+        k = (k << 31) | (k >> 33);
+        k *= 0x4cf5ad432745937f;
+        h ^= k;
+        h = (h << 27) | (h >> 37);
+        return h * 5 + 0x52dce729;
+    };
+
+    u64 h = seed ^ (u64(size) * 0x9e3779b97f4a7c15);
+
+    size_t i = 0;
+    for(; i + sizeof(u64) <= size; i += sizeof(u64)) {
+        u64 k = 0;
+        std::memcpy(&k, bytes + i, sizeof(u64));
+        h = mix(h, k);
+    }
+
+    if(i != size) {
+        u64 tail = 0;
+        std::memcpy(&tail, bytes + i, size - i);
+        h = mix(h, tail);
+    }
+
+    // Final avalanche
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+    return h;
+}
+
 }
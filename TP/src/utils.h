@@ -202,6 +202,9 @@ Result<std::string> read_text_file(const std::string& file_name);
 
 bool ends_with(std::string_view str, std::string_view suffix);
 
+// Fast non cryptographic hash of raw bytes
+u64 hash_bytes(const void* data, size_t size, u64 seed = 0xd5a7de585d2af52b);
+
 }
 
 #endif // UTILS_H